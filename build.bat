@@ -24,5 +24,5 @@ if "%~1" == "resources" (
     mkdir SDLGame_Web >nul 2>&1
     del /f /q "SDLGame_Web\game.js" "SDLGame_Web\game.wasm" >nul 2>&1
     :: -s LEGACY_GL_EMULATION=1
-    em++ "src\main.cpp" "src\engine.cpp" -O3 -s -flto -ffunction-sections -fdata-sections -std=c++11 -pipe -Wall -Wextra -Wpedantic -Wno-unused-parameter -Wno-write-strings -Wno-dollar-in-identifier-extension -DNDEBUG -s ASSERTIONS=1 -s EMULATE_FUNCTION_POINTER_CASTS=1 -s ALLOW_MEMORY_GROWTH=1 -s FULL_ES2=1 -s USE_SDL=2 -s USE_SDL_TTF=2 -s USE_SDL_IMAGE=2 -s SDL2_IMAGE_FORMATS="['png']" -o "SDLGame_Web\game.js" %*
+    em++ "src\main.cpp" "src\engine.cpp" "src\input.cpp" "src\pacer.cpp" "src\profiler.cpp" "src\registry.cpp" "src\ui.cpp" "src\batch.cpp" "src\pack.cpp" "src\loader.cpp" "src\watcher.cpp" "src\collision.cpp" "src\level.cpp" "src\camera.cpp" "src\prefetch.cpp" -O3 -s -flto -ffunction-sections -fdata-sections -std=c++11 -pipe -Wall -Wextra -Wpedantic -Wno-unused-parameter -Wno-write-strings -Wno-dollar-in-identifier-extension -DNDEBUG -s ASSERTIONS=1 -s EMULATE_FUNCTION_POINTER_CASTS=1 -s ALLOW_MEMORY_GROWTH=1 -s FULL_ES2=1 -s USE_SDL=2 -s USE_SDL_TTF=2 -s USE_SDL_IMAGE=2 -s SDL2_IMAGE_FORMATS="['png']" -o "SDLGame_Web\game.js" %*
 )
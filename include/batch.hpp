@@ -0,0 +1,78 @@
+#ifndef __BATCH_HPP
+#define __BATCH_HPP
+
+#include <vector>
+#include <cstdint>
+#include <SDL2/SDL.h>
+
+// Submit whole groups with SDL_RenderGeometry (added in SDL 2.0.18)
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	#define BATCH_GEOMETRY
+	typedef SDL_Vertex BatchVertex;
+#else
+	struct BatchVertex {
+		SDL_FPoint position;
+		SDL_Color color;
+		SDL_FPoint tex_coord;
+	};
+#endif
+
+#define BATCH_LOOKBACK 8 // Earlier runs searched for the same texture
+
+class Engine;
+
+enum { // Used by BatchItem
+	BATCH_QUAD, BATCH_RECT,
+	BATCH_LINE, BATCH_TRIANGLE
+};
+
+struct BatchItem {
+	int type;
+	int layer;
+	SDL_Texture* texture;
+	SDL_BlendMode blend;
+	uint32_t first; // First vertex
+	SDL_Rect src, dst; // Used by fallback path
+	SDL_RendererFlip flip;
+};
+
+struct BatchRun {
+	SDL_Texture* texture;
+	SDL_BlendMode blend;
+	SDL_FRect bounds; // Covers every item in the run
+	uint32_t count;
+};
+
+class SpriteBatch {
+private:
+	std::vector<BatchItem> items;
+	std::vector<BatchVertex> vertices;
+	std::vector<BatchRun> runs;
+	std::vector<uint32_t> itemRuns;
+	std::vector<BatchItem> sorted;
+	std::vector<BatchVertex> groupVertices;
+	std::vector<int> groupIndices;
+	SDL_Texture* sizeTexture;
+	int sizeW, sizeH;
+	BatchItem* AddItem(int type, SDL_Texture* texture, int layer, SDL_BlendMode blend);
+	void AddVertex(float x, float y, SDL_Color color, float u = 0, float v = 0);
+	SDL_FRect Bounds(const BatchItem &item);
+	void Regroup();
+	void Submit(Engine* engine, size_t first, size_t last);
+	void SubmitFallback(Engine* engine, const BatchItem &item);
+public:
+	uint32_t drawCalls;
+	uint32_t drawVertices;
+
+	SpriteBatch();
+	void AddQuad(SDL_Texture* texture, const SDL_Rect* src, const SDL_Rect* dst, SDL_Color color = { 255, 255, 255, 255 },
+		SDL_RendererFlip flip = SDL_FLIP_NONE, int layer = 0, SDL_BlendMode blend = SDL_BLENDMODE_BLEND);
+	void AddRect(const SDL_Rect* rect, SDL_Color color, int layer = 0, SDL_BlendMode blend = SDL_BLENDMODE_BLEND);
+	void AddLine(int x1, int y1, int x2, int y2, SDL_Color color, int layer = 0, SDL_BlendMode blend = SDL_BLENDMODE_BLEND);
+	void AddTriangle(SDL_FPoint a, SDL_FPoint b, SDL_FPoint c, SDL_Color color, int layer = 0, SDL_BlendMode blend = SDL_BLENDMODE_BLEND);
+	bool Empty();
+	void Forget(SDL_Texture* texture);
+	void Flush(Engine* engine);
+};
+
+#endif
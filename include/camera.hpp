@@ -0,0 +1,25 @@
+#ifndef __CAMERA_HPP
+#define __CAMERA_HPP
+
+#include <cstdint>
+
+// Chunks kept ready on each side of the viewport (built before they scroll into view)
+#define CAMERA_MARGIN 1
+
+// Follows a point over a world made of a row of fixed size chunks
+class Camera {
+public:
+	double x; // Left edge of the viewport in world coordinates
+	int w, h; // Viewport size
+	int chunkW; // Chunk width
+	uint32_t chunks; // Chunks in the world
+	uint32_t margin;
+
+	Camera(int w, int h);
+	void SetWorld(uint32_t chunks, int chunkW);
+	void Follow(double x);
+	bool Visible(uint32_t &first, uint32_t &last, uint32_t margin = 0);
+	bool IsNear(uint32_t chunk);
+};
+
+#endif
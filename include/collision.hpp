@@ -0,0 +1,42 @@
+#ifndef __COLLISION_HPP
+#define __COLLISION_HPP
+
+#include <vector>
+#include <cstdint>
+#include <SDL2/SDL.h>
+
+// Default grid cell size in pixels (a few player sizes)
+#define COLLISION_CELL 128
+
+// Passes of Move (each slides the rest of the movement along the surface that was hit)
+#define COLLISION_PASSES 3
+
+enum { // Contact flags returned by CollisionGrid::Move
+	CONTACT_GROUND = 1, CONTACT_CEILING = 2,
+	CONTACT_LEFT = 4, CONTACT_RIGHT = 8
+};
+
+// Static rectangles bucketed into a uniform grid (queries only touch nearby cells)
+class CollisionGrid {
+private:
+	int cell;
+	int originX, originY; // Top left corner of the grid
+	int cols, rows;
+	std::vector<SDL_Rect> rects;
+	std::vector<uint32_t> cellStart; // First item of each cell (one extra entry marks the end)
+	std::vector<uint32_t> cellItems; // Rectangle indices sorted by cell
+	std::vector<uint32_t> marks; // Last query that returned each rectangle
+	uint32_t mark;
+	std::vector<uint32_t> found; // Used by Move
+public:
+	uint64_t queries;
+	uint64_t tests; // Rectangles tested by queries
+
+	CollisionGrid();
+	void Build(const SDL_Rect* rects, size_t count, int cell = COLLISION_CELL);
+	size_t Count();
+	size_t Query(const SDL_Rect &area, std::vector<uint32_t> &out);
+	int Move(double &x, double &y, int w, int h, double dx, double dy);
+};
+
+#endif
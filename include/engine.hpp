@@ -1,7 +1,11 @@
 #ifndef __ENGINE_HPP
 #define __ENGINE_HPP
 
+#include <map>
+#include <list>
+#include <atomic>
 #include <string>
+#include <vector>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 #include <SDL2/SDL_image.h>
@@ -9,12 +13,23 @@
 	#include <SDL2/SDL_mixer.h>
 	#include <SDL2/SDL_syswm.h>
 #endif
+#include "pack.hpp"
+#include "batch.hpp"
+#include "loader.hpp"
+#include "registry.hpp"
 
 enum { // Used by DrawTriangle function
 	TRIANGLE_UP, TRIANGLE_DOWN,
 	TRIANGLE_LEFT, TRIANGLE_RIGHT
 };
 
+enum { // Batch layers (lower layers are drawn first, same layer in order of submission)
+	LAYER_BACKGROUND, // Default layer
+	LAYER_STAGE, // Stage shapes and platforms
+	LAYER_PLAYER,
+	LAYER_HUD // Counters drawn over everything
+};
+
 enum { // Used by ConnectTextures function
 	CONNECT_1ON2, CONNECT_2ON1,
 	CONNECT_1LEFT2, CONNECT_2LEFT1,
@@ -23,46 +38,204 @@ enum { // Used by ConnectTextures function
 	CONNECT_1BOTTOM2, CONNECT_2BOTTOM1
 };
 
+// Glyph range stored in glyph atlases (printable ASCII)
+#define GLYPH_FIRST 32
+#define GLYPH_LAST 126
+#define GLYPH_ATLAS_WIDTH 512
+
+enum { // Used by GetText function
+	TEXT_BLENDED, TEXT_SOLID
+};
+
+// Default audio settings (512 samples at 48 kHz is 10.7 ms of latency)
+#define AUDIO_RATE 48000
+#define AUDIO_SAMPLES 512
+#define AUDIO_VOICES 16
+
+// Default text cache budget (bytes of texture memory)
+#define TEXT_CACHE_BUDGET (4 * 1024 * 1024)
+
+struct TextKey { // Used by text cache
+	TTF_Font* font;
+	std::string text;
+	uint32_t color;
+	int mode;
+	bool operator<(const TextKey &other) const;
+};
+
+struct TextEntry { // Used by text cache
+	SDL_Texture* texture;
+	size_t bytes;
+	std::list<TextKey>::iterator order;
+};
+
+struct GlyphAtlas { // Used by DrawGlyphs function
+	SDL_Texture* texture;
+	SDL_Rect glyphs[GLYPH_LAST - GLYPH_FIRST + 1];
+	int advances[GLYPH_LAST - GLYPH_FIRST + 1];
+	int height;
+};
+
+struct Sprite { // Used by DrawSprite function
+	SDL_Texture* texture; // Atlas page or loose image
+	SDL_Rect rect; // Area of the texture
+};
+
 class Engine {
 private:
 	const char* title;
 	int wx, wy, ww, wh;
+	std::map<TextKey, TextEntry> texts;
+	std::list<TextKey> textOrder; // Most recently used first
+	void TrimTextCache();
+
+	// Renderer state (valid flags are cleared when state is unknown)
+	SDL_Color color;
+	SDL_BlendMode blendMode;
+	SDL_Texture* target;
+	SDL_Rect clip;
+	SDL_Rect viewport;
+	bool colorValid, blendValid, targetValid, clipValid, viewportValid;
+	bool StateChanged(bool changed);
+
+	// Sprites by ID and textures holding them (atlas pages and loose images)
+	std::vector<Sprite> sprites;
+	std::map<std::string, int> spriteIds;
+	std::vector<SDL_Texture*> spriteTextures;
+	std::map<std::string, SDL_Texture*> spritePaths; // Image file of each sprite texture (used by ReloadTexture)
+	int AddSprite(const char* name, SDL_Texture* texture, SDL_Rect rect);
+
+	// Assets decoded by AssetLoader (taken by the path loaders)
+	std::map<std::string, SDL_Texture*> preloadedTextures;
+	std::map<std::string, std::vector<uint8_t>> preloadedFiles; // Kept while fonts use them
+	#ifndef __EMSCRIPTEN__
+		std::map<std::string, Mix_Chunk*> preloadedSounds;
+
+		// Audio thread work (measured between post mix callbacks)
+		std::atomic<uint64_t> audioFrames;
+		std::atomic<uint64_t> audioCpu; // Nanoseconds
+		uint64_t audioLastCpu; // Used only by the audio thread
+		uint64_t audioLastCounter; // Used only by the audio thread
+		int audioFrameSize;
+		static void PostMix(void* data, Uint8* stream, int len);
+
+		// Priority and start time of the sound playing on each voice
+		std::vector<int> voicePriority;
+		std::vector<uint32_t> voiceStart;
+	#endif
 public:
 	SDL_Window* w;
 	SDL_Renderer* r;
+	SDL_Surface* s;
 	#ifndef __EMSCRIPTEN__
 		SDL_SysWMinfo i;
 	#endif
 	std::string lastError;
+	bool vsync;
+	bool headless;
+
+	// Asset pack (loaders look here first, then on disk)
+	AssetPack pack;
+
+	// Batched quads and triangles (flushed before any immediate drawing or state change)
+	SpriteBatch batch;
+	bool flushing;
+
+	// Draw calls and vertices (current and last presented frame)
+	uint32_t drawCalls;
+	uint32_t drawVertices;
+	uint32_t frameDrawCalls;
+	uint32_t frameDrawVertices;
+
+	// Renderer state calls made and skipped (current and last presented frame)
+	uint32_t stateCalls;
+	uint32_t stateSkips;
+	uint32_t frameStateCalls;
+	uint32_t frameStateSkips;
+	uint64_t totalStateCalls;
+	uint64_t totalStateSkips;
+
+	#ifndef __EMSCRIPTEN__
+		// Audio device and mixer statistics
+		int audioRate;
+		int audioSamples;
+		std::atomic<uint64_t> audioCallbacks;
+		std::atomic<uint64_t> audioUnderruns;
+		std::atomic<uint64_t> audioMaxCpu; // Nanoseconds
+		uint64_t voiceSteals;
+		uint64_t voiceDrops;
+	#endif
+
+	// Text cache budget and statistics
+	size_t textCacheBudget;
+	size_t textCacheBytes;
+	uint64_t textHits;
+	uint64_t textMisses;
+	uint64_t textEvictions;
 
 	Engine(const char* title, int x, int y, int w, int h);
 	~Engine();
 	bool Init();
+	bool InitHeadless();
 	void ShowWindow(bool show = true);
 	void RaiseWindow();
+	void ResetState();
 	int SetColor(SDL_Color color);
+	int SetBlendMode(SDL_BlendMode mode);
 	int SetTarget(SDL_Texture* target);
+	int SetClip(const SDL_Rect* rect);
+	int SetViewport(const SDL_Rect* rect);
+	std::string StateReport();
 	int Clear();
 	void Present();
+	void FlushBatch();
 	int DrawLine(int x, int y, int w, int h);
+	int FillRect(const SDL_Rect* rect);
 	int Draw(SDL_Texture* texture, const SDL_Rect* srcrect = NULL, const SDL_Rect* dstrect = NULL,
 		const double angle = 0, const SDL_Point* center = NULL, const SDL_RendererFlip flip = SDL_FLIP_NONE);
 	int QueryTexture(SDL_Texture* txt, SDL_Rect* rect, uint32_t* format = NULL, int* access = NULL);
-	SDL_Texture* CreateTexture(int w, int h, int access = SDL_TEXTUREACCESS_STATIC);
+	SDL_Texture* CreateTexture(int w, int h, int access = SDL_TEXTUREACCESS_STATIC, const char* tag = "CreateTexture");
 	SDL_Texture* ConnectTextures(SDL_Texture* txt1, SDL_Texture* txt2, int method = 0, bool destroy = false);
-	SDL_Texture* SurfaceToTexture(SDL_Surface* surface);
+	SDL_Texture* SurfaceToTexture(SDL_Surface* surface, const char* tag = "SurfaceToTexture");
+	bool OpenPack(const char* path);
+	void Preload(LoadJob* job);
+	void ClearPreloaded();
+	std::string ReadText(const char* path);
 	SDL_Texture* LoadTexture(const char* path);
-	SDL_Texture* LoadTexture(SDL_RWops* data);
+	SDL_Texture* LoadTexture(SDL_RWops* data, const char* tag = "LoadTexture");
 	#ifndef __EMSCRIPTEN__
 		Mix_Chunk* LoadSound(const char* path);
-		Mix_Chunk* LoadSound(SDL_RWops* data);
+		Mix_Chunk* LoadSound(SDL_RWops* data, const char* tag = "LoadSound");
+		Mix_Music* LoadMusic(const char* path);
+		bool InitAudio(int rate = AUDIO_RATE, int samples = AUDIO_SAMPLES, int voices = AUDIO_VOICES);
+		int PlaySound(Mix_Chunk* sound, int priority = 0, uint8_t volume = 100, int loops = 0);
+		void StopSounds();
+		std::string AudioReport();
 	#endif
 	TTF_Font* LoadFont(const char* path, int size);
-	TTF_Font* LoadFont(SDL_RWops* data, int size);
+	TTF_Font* LoadFont(SDL_RWops* data, int size, const char* tag = "LoadFont");
 	SDL_Texture* RenderText(TTF_Font* font, std::string text, SDL_Color color);
 	SDL_Texture* RenderSolidText(TTF_Font* font, std::string text, SDL_Color color);
-	SDL_Texture* CreateOverlay(int w, int h, SDL_Color color = { 0, 0, 0, 100 });
+	SDL_Texture* GetText(TTF_Font* font, const std::string &text, SDL_Color color, int mode = TEXT_BLENDED);
+	void SetTextCacheBudget(size_t bytes);
+	void ClearTextCache();
+	std::string TextCacheReport();
+	GlyphAtlas* CreateGlyphAtlas(TTF_Font* font);
+	void DestroyGlyphAtlas(GlyphAtlas* atlas);
+	int DrawGlyphs(GlyphAtlas* atlas, const char* text, int x, int y, SDL_Color color, int layer = 0);
+	int LoadAtlas(const char* path);
+	std::vector<std::string> GetAtlasPages(const char* path);
+	int LoadSprite(const char* name, const char* path);
+	int LoadSprite(const char* name, SDL_RWops* data, const char* tag = "LoadSprite");
+	int GetSprite(const char* name);
+	bool GetSpriteSize(int id, int* w, int* h);
+	bool DrawSprite(int id, const SDL_Rect* dstrect = NULL, SDL_RendererFlip flip = SDL_FLIP_NONE,
+		SDL_Color color = { 255, 255, 255, 255 }, int layer = 0);
+	void FreeSprites();
+	bool ReloadTexture(LoadJob* job);
+	SDL_Texture* CreateOverlay(int w, int h, SDL_Color color = { 0, 0, 0, 100 }, const char* tag = "CreateOverlay");
 	bool DrawTriangle(int x, int y, SDL_Color color, int size, int direction = TRIANGLE_UP);
+	bool BatchTriangle(int x, int y, SDL_Color color, int size, int direction = TRIANGLE_UP, int layer = 0);
 	bool DrawButton(TTF_Font* font, std::string text, SDL_Rect rect, SDL_Color font_color,
 		SDL_Color bg_color, SDL_Color border_color, int padding_x = 14, int padding_y = 6, int border_size = 3);
 };
@@ -18,8 +18,17 @@
 	#include <windows.h>
 	#include <fcntl.h>
 #endif
+#include "ui.hpp"
+#include "level.hpp"
+#include "camera.hpp"
+#include "engine.hpp"
+#include "collision.hpp"
+#include "prefetch.hpp"
+#ifndef __EMSCRIPTEN__
+	#include "watcher.hpp"
+#endif
 
-// Starting frame and key used for enabling/disabling counter
+// Starting frame, key used for enabling/disabling counter and its line count
 #ifndef __EMSCRIPTEN__
 	#ifndef NDISCORD
 		#define DEFAULT_FRAME 4
@@ -27,9 +36,11 @@
 		#define DEFAULT_FRAME 2
 	#endif
 	#define COUNTER_KEYCODE SDL_SCANCODE_F1
+	#define COUNTER_LINES 9
 #else
 	#define DEFAULT_FRAME 2
 	#define COUNTER_KEYCODE SDL_SCANCODE_GRAVE
+	#define COUNTER_LINES 8
 #endif
 
 // Game title and version
@@ -49,8 +60,12 @@ double posX = 30;
 double posY = height - sizeY;
 double tmpX, tmpY;
 
-// Static FPS value
+// Startup time counter (cleared after the first frame)
+uint64_t launchCounter;
+
+// Static FPS value (0 = uncapped)
 uint32_t fps = 60;
+bool vsync;
 
 // For resizing and setting position
 SDL_Rect rect;
@@ -58,16 +73,23 @@ SDL_Rect rect;
 // For flipping character
 SDL_RendererFlip flip;
 
-// For events
-SDL_Event e;
-
-// For keyboard handling
-const uint8_t* key;
+// Input actions
+enum {
+	ACTION_LEFT, ACTION_RIGHT, ACTION_UP, ACTION_DOWN, ACTION_JUMP,
+	ACTION_ACCEPT, ACTION_BACK, ACTION_COUNTER, ACTIONS
+};
+const char* actionNames[ACTIONS] = {
+	"left", "right", "up", "down", "jump",
+	"accept", "back", "counter"
+};
+SDL_Scancode defaultKeys[ACTIONS] = {
+	SDL_SCANCODE_LEFT, SDL_SCANCODE_RIGHT, SDL_SCANCODE_UP, SDL_SCANCODE_DOWN, SDL_SCANCODE_UP,
+	SDL_SCANCODE_RETURN, SDL_SCANCODE_ESCAPE, COUNTER_KEYCODE
+};
 
 // For mouse handling
 int mouseX, mouseY;
 int lastX, lastY;
-uint32_t mouse;
 
 // For FPS counting
 uint32_t fpsFrameTicks;
@@ -77,12 +99,7 @@ uint32_t fpsCount = 0;
 // Main menu option
 uint8_t option = 1;
 
-// Key locks
-bool escKey;
-bool optKey;
-bool enterKey;
-bool jumpKey;
-bool counterKey;
+// Mouse lock (dragging trackbar)
 bool mouseLock;
 
 // Switches
@@ -90,23 +107,27 @@ bool debug;
 bool demo;
 bool isPlaying;
 bool showCounter;
-
-// Resources
-SDL_Texture* bg;
-SDL_Texture* menubg;
-SDL_Texture* player;
-SDL_Texture* text;
-SDL_Texture* overlay;
-SDL_Texture* trackbar;
-SDL_Texture* counter0;
-SDL_Texture* counter1;
-SDL_Texture* counter2;
-SDL_Texture* counter3;
-SDL_Texture* counter4;
-SDL_Texture* counter5;
-
-// Option resources
-SDL_Texture* volumeLabel;
+bool headless;
+bool noRender;
+
+// Resources (sprites are owned by engine)
+int bgSprite = -1;
+int menubgSprite = -1;
+int playerSprite = -1;
+Texture overlay;
+
+// Glyph atlas for counters (drawn every frame without TTF calls)
+GlyphAtlas* counterAtlas;
+
+// Menus (widgets are composed once and redrawn only when changed)
+UI mainMenu(width, height);
+UI optionsMenu(width, height);
+UI dialogMenu(width, height);
+Widget* menuButtons[3];
+Widget* volumeLabel;
+Widget* volumeBar;
+Widget* dialogText;
+Widget* dialogButton;
 
 // Colors
 SDL_Color black = { 0, 0, 0, 255 };
@@ -116,13 +137,13 @@ SDL_Color white = { 255, 255, 255, 255 };
 SDL_Color dimwhite = { 230, 230, 230, 255 };
 
 // Fonts
-TTF_Font* buttonFont;
-TTF_Font* optionFont;
-TTF_Font* counterFont;
+Font buttonFont;
+Font optionFont;
+Font counterFont;
 
 // Sounds
 #ifndef __EMSCRIPTEN__
-	Mix_Chunk* bgsound;
+	Music bgmusic;
 #endif
 uint8_t volume = 100;
 
@@ -131,13 +152,27 @@ uint32_t frame = DEFAULT_FRAME;
 uint32_t lastFrame;
 uint32_t lastGameFrame;
 uint32_t gameFrame = 1;
-int8_t gameFrameChange;
-#define GAME_FRAMES 3
 
-// Render targets (for the game frame scrolling)
-SDL_Texture* render1;
-SDL_Texture* render2;
-int renderPos;
+// Stages of the game (one per game frame, from levels/levels.bin or built in)
+Level level;
+
+// Synthetic level with this many stages (for benchmarks, 0 = off)
+uint32_t worldStages;
+
+// Game frames are chunks of one continuous world, camera shows the ones around the player
+Camera camera(width, height);
+uint64_t chunksDrawn;
+
+// Static content of game frames near the camera by stage (rendered once)
+std::map<uint32_t, Texture> stageLayers;
+size_t maxStageLayers;
+uint64_t stageLayersRendered;
+uint64_t stageLayersPrefetched;
+uint64_t viewChanges; // Chunks entering or leaving the viewport
+
+// Prepare stages before they come into view (platforms on a worker thread, layers in frames with nothing to render)
+bool prefetch = true;
+StagePrefetcher prefetcher;
 
 // Gravity values
 uint8_t jumpState;
@@ -145,7 +180,19 @@ double gravity = 600.0;
 double velocityY;
 double speed = 200.0;
 double jumpStrength = 350.0;
-double delta = 0.02;
+
+// Fixed timestep values
+double delta = 0.02; // Simulation step (50 updates per second)
+double maxFrameTime = 0.25;
+double frameTime;
+double accumulator;
+double alpha;
+uint64_t lastCounter;
+uint64_t updates;
+
+// Player position at the previous update (for interpolation)
+double prevX = posX;
+double prevY = posY;
 
 // Is user a spectator?
 bool spectating;
@@ -154,18 +201,10 @@ bool connected;
 // Demo walking direction
 bool demoDirection;
 
-// Collisions (TODO)
-uint8_t collisionCounts[GAME_FRAMES] = { 2, 1, 1 };
-SDL_Rect* collisions[GAME_FRAMES] = {
-	new SDL_Rect[2] {
-		{ 460, 440, 50, 15 },
-		{ 630, 540, 60, 15 }
-	}, new SDL_Rect[1] {
-		{ 620, 540, 70, 15 }
-	}, new SDL_Rect[1] {
-		{ 610, 540, 80, 15 }
-	}
-};
+// Platforms of the current game frame and its neighbours (taken from prefetcher when the stage changes)
+CollisionGrid stageGrid;
+std::vector<SDL_Rect> gridRects;
+uint32_t gridStage;
 
 // Dialog box data
 struct {
@@ -178,12 +217,43 @@ struct {
 } dialogBox;
 
 #ifndef __EMSCRIPTEN__
-	// Used to count delay between frames
-	uint32_t frameTicks;
-
 	// Used to end main loop
 	bool quit;
 
+	// Profiler trace output file
+	std::string tracePath;
+
+	// Benchmark frame count, output file and frame times (in milliseconds)
+	uint32_t benchFrames;
+	std::string benchPath;
+	std::vector<double> benchTimes;
+	std::vector<uint32_t> benchTransitions; // Frames where the stage or the chunks in view changed
+
+	// Input recording and replay files
+	std::string recordPath;
+	std::string replayPath;
+
+	// Audio settings (from config)
+	int audioRate = AUDIO_RATE;
+	int audioSamples = AUDIO_SAMPLES;
+	int audioVoices = AUDIO_VOICES;
+
+	// Asset loading threads (0 = one per core)
+	uint32_t loadThreads;
+
+	// Reload images and fonts changed on disk (--watch)
+	bool watch;
+	AssetWatcher watcher;
+
+	// Replay file header (state needed to start the same session)
+	struct ReplayHeader {
+		uint32_t seed;
+		uint32_t frame;
+		uint32_t demo;
+		uint32_t isPlaying;
+		uint32_t tickRate;
+	};
+
 	// Server connection
 	easysock::tcp::Client* conn;
 	bool skipconnect;
@@ -258,16 +328,6 @@ void Log(std::string msg) {
 	}
 }
 
-/*bool CheckCollision() {
-	for(uint8_t i = 0; i < collisionCounts[gameFrame - 1]; i++) {
-		rect = collisions[gameFrame - 1][i];
-		if(posX + sizeX > rect.x && posX < rect.x + rect.w && posY + sizeY > rect.y && posY < rect.y + rect.h) {
-			return true;
-		}
-	}
-	return false;
-}*/
-
 char* RandomStr(char* target, int len, const char* chars = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz") {
 	if(len > 100) return NULL;
 	int charsLen = strlen(chars) - 1;
@@ -330,7 +390,11 @@ bool Unserialize(std::string data, uint32_t &frame, double &x, double &y) {
 	if(vars.size() != 3) {
 		return false;
 	}
-	frame = std::stoi(vars[0]);
+	uint32_t stage = std::stoi(vars[0]);
+	if(stage < 1 || stage > level.Count()) {
+		return false;
+	}
+	frame = stage;
 	x = std::stoi(vars[1]);
 	y = std::stoi(vars[2]);
 	return true;
@@ -0,0 +1,68 @@
+#ifndef __INPUT_HPP
+#define __INPUT_HPP
+
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <SDL2/SDL.h>
+
+// Maximum action count (actions are stored as bits) and keys per action
+#define INPUT_ACTIONS 32
+#define INPUT_BINDS 4
+
+// Replay file signature and version
+#define INPUT_REPLAY_MAGIC "SDLR"
+#define INPUT_REPLAY_VERSION 1
+
+struct InputState {
+	uint32_t down;     // Held actions
+	uint32_t pressed;  // Actions pressed since last check
+	uint32_t released; // Actions released since last check
+	int32_t mouseX, mouseY;
+	uint32_t buttons;  // Held mouse buttons (SDL_BUTTON masks)
+	uint32_t clicked;  // Mouse buttons pressed since last check
+};
+
+class Input {
+private:
+	SDL_Scancode binds[INPUT_ACTIONS][INPUT_BINDS];
+	uint32_t pressTime[INPUT_ACTIONS];
+	FILE* file;
+	InputState last;
+	void SetAction(int action, bool down, uint32_t timestamp);
+public:
+	InputState state;
+	bool quit;
+
+	// Recording and replay
+	bool recording;
+	bool replaying;
+	uint64_t syncFrames;
+
+	// Latency between key press event and its handling (in milliseconds, not measured in replays)
+	uint64_t presses;
+	uint64_t latencySamples;
+	uint64_t latencyTotal;
+	uint32_t latencyMax;
+
+	Input();
+	~Input();
+	void Bind(int action, SDL_Scancode key);
+	bool Bind(int action, std::string keys);
+	void Unbind(int action);
+	std::string GetBinding(int action);
+	void Poll();
+	void Flush();
+	bool Down(int action);
+	bool Pressed(int action);
+	bool Released(int action);
+	bool MouseDown(int button);
+	bool Clicked(int button);
+	bool StartRecording(const char* path, const void* header, uint32_t size);
+	bool StartReplay(const char* path, void* header, uint32_t size);
+	void Stop();
+	bool Sync(double &time);
+	std::string Report();
+};
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef __LEVEL_HPP
+#define __LEVEL_HPP
+
+#include <vector>
+#include <cstdint>
+#include <SDL2/SDL.h>
+#include "pack.hpp"
+
+// Level file format (little endian, used in place from the mapped file)
+// Header is followed by the stage table, platform rectangles and shapes
+#define LEVEL_MAGIC "SDLL"
+#define LEVEL_VERSION 1
+
+enum { // Used by LevelStage
+	STAGE_FLIP = 1 // Background is flipped horizontally
+};
+
+enum { // Used by LevelShape
+	SHAPE_TRIANGLE // Direction is one of TRIANGLE_* values
+};
+
+struct LevelHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t stageCount;
+	uint32_t rectCount;
+	uint32_t shapeCount;
+	uint32_t reserved;
+};
+
+struct LevelStage {
+	uint32_t flags;
+	uint32_t firstRect; // Index into platform rectangles
+	uint32_t rectCount;
+	uint32_t firstShape; // Index into shapes
+	uint32_t shapeCount;
+	uint32_t reserved;
+};
+
+struct LevelShape {
+	uint8_t type;
+	uint8_t direction;
+	uint8_t layer; // Batch layer
+	uint8_t reserved;
+	int32_t x, y;
+	int32_t size;
+	SDL_Color color;
+};
+
+class Level {
+private:
+	MappedFile file;
+	std::vector<uint8_t> owned; // Level built in memory
+	const LevelStage* stages;
+	const SDL_Rect* rects;
+	const LevelShape* shapes;
+	uint32_t count;
+	size_t size;
+	bool Attach(const uint8_t* data, size_t size);
+public:
+	Level();
+	bool Open(const char* path);
+	bool Open(const void* data, size_t size);
+	bool Adopt(std::vector<uint8_t> &data);
+	void Close();
+	uint32_t Count();
+	size_t Size();
+	const LevelStage* Stage(uint32_t index);
+	const SDL_Rect* Rects(const LevelStage* stage);
+	const LevelShape* Shapes(const LevelStage* stage);
+	void Prefetch(const LevelStage* stage);
+};
+
+// Writes levels in the format read by Level (stages are filled in order)
+class LevelBuilder {
+private:
+	std::vector<LevelStage> stages;
+	std::vector<SDL_Rect> rects;
+	std::vector<LevelShape> shapes;
+public:
+	void AddStage(uint32_t flags = 0);
+	void AddRect(SDL_Rect rect);
+	void AddTriangle(int x, int y, int size, int direction, SDL_Color color, int layer = 1);
+	uint32_t Count();
+	std::vector<uint8_t> Build();
+	bool Save(const char* path);
+};
+
+#endif
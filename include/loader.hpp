@@ -0,0 +1,67 @@
+#ifndef __LOADER_HPP
+#define __LOADER_HPP
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <SDL2/SDL.h>
+#ifndef __EMSCRIPTEN__
+	#include <SDL2/SDL_mixer.h>
+#endif
+#include "pack.hpp"
+
+enum { // Used by LoadJob
+	LOAD_IMAGE, // Decoded to a surface
+	LOAD_FILE, // Read into memory (fonts)
+	LOAD_SOUND // Decoded to PCM
+};
+
+struct LoadJob {
+	int type;
+	std::string path;
+	bool failed;
+	std::string error;
+	SDL_Surface* surface;
+	std::vector<uint8_t> data;
+	#ifndef __EMSCRIPTEN__
+		Mix_Chunk* sound;
+	#endif
+
+	LoadJob(int type, const std::string &path);
+};
+
+// Run job on the calling thread (pack is optional) and free results nobody took
+void LoadAsset(LoadJob &job, AssetPack* pack = NULL);
+void FreeAsset(LoadJob &job);
+
+class AssetLoader {
+private:
+	AssetPack* pack;
+	std::vector<LoadJob> jobs;
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	size_t queued; // Next job to run
+	size_t taken; // Jobs returned by Next
+	std::deque<size_t> ready; // Finished and not taken yet
+	void Run(size_t index);
+	void Work();
+public:
+	uint32_t threads;
+	uint64_t startCounter;
+	double seconds; // Time from Start until the last job was taken
+
+	AssetLoader(AssetPack* pack = NULL);
+	~AssetLoader();
+	void Add(int type, const char* path);
+	void Start(uint32_t threads = 0);
+	LoadJob* Next();
+	bool Done();
+	size_t Total();
+	size_t Finished();
+	void Join();
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef __PACER_HPP
+#define __PACER_HPP
+
+#include <string>
+#include <cstdint>
+#include <SDL2/SDL.h>
+
+enum { // Used by Pacer class
+	PACER_CAPPED, PACER_VSYNC, PACER_UNCAPPED
+};
+
+// Oversleep histogram bucket count (upper bounds are in pacer.cpp)
+#define PACER_BUCKETS 7
+
+class Pacer {
+private:
+	uint64_t freq;
+	uint64_t period;
+	uint64_t deadline;
+	uint64_t spin;
+	uint64_t sleepError;
+public:
+	int mode;
+	uint32_t rate;
+
+	// Pacing statistics
+	uint64_t frames;
+	uint64_t missed;
+	uint64_t oversleep[PACER_BUCKETS];
+	double maxOversleep;
+
+	Pacer(int mode = PACER_CAPPED, uint32_t rate = 60);
+	void SetMode(int mode, uint32_t rate = 0);
+	void Wait();
+	void ResetStats();
+	std::string Report();
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef __PACK_HPP
+#define __PACK_HPP
+
+#include <map>
+#include <string>
+#include <cstdint>
+#include <SDL2/SDL.h>
+
+// Asset pack format (little endian, entry data aligned to PACK_ALIGN bytes)
+#define PACK_MAGIC "SDLP"
+#define PACK_VERSION 1
+#define PACK_ALIGN 16
+#define PACK_NAME_SIZE 48
+
+enum { // Used by PackEntry
+	PACK_RAW, // File copied as is (fonts, sounds, text)
+	PACK_PIXELS // Decoded image in the entry's pixel format
+};
+
+struct PackHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t count; // Number of entries in the table of contents
+	uint32_t reserved;
+};
+
+struct PackEntry {
+	char name[PACK_NAME_SIZE]; // Path relative to the game directory (e.g. "images/bg.png")
+	uint32_t type;
+	uint32_t format; // SDL pixel format (PACK_PIXELS only)
+	uint32_t width;
+	uint32_t height;
+	uint32_t pitch;
+	uint32_t reserved;
+	uint64_t offset; // From the start of the pack
+	uint64_t size;
+};
+
+// Read-only file mapped into memory (read into memory in the browser)
+class MappedFile {
+private:
+	const uint8_t* data;
+	size_t size;
+	#ifdef _WIN32
+		void* file;
+		void* mapping;
+	#endif
+public:
+	MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+	bool Open(const char* path);
+	void Close();
+	const uint8_t* Data();
+	size_t Size();
+	static void Prefetch(const void* data, size_t size);
+};
+
+class AssetPack {
+private:
+	MappedFile file;
+	std::map<std::string, const PackEntry*> entries;
+public:
+	~AssetPack();
+	bool Open(const char* path);
+	void Close();
+	bool IsOpen();
+	const PackEntry* Find(const std::string &name);
+	const void* Data(const PackEntry* entry);
+	SDL_RWops* Read(const std::string &name);
+	size_t Count();
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef __PREFETCH_HPP
+#define __PREFETCH_HPP
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <condition_variable>
+#include "level.hpp"
+#include "collision.hpp"
+
+// Platforms of the stage and its neighbours, relative to the stage (player crosses stage edges)
+void BuildStageGrid(Level &level, uint32_t stage, int width, std::vector<SDL_Rect> &rects, CollisionGrid &grid);
+
+// Reads stages before the player enters them and builds their collision grids (on a worker thread on desktop)
+class StagePrefetcher {
+private:
+	Level* level;
+	int width;
+	std::thread thread;
+	std::mutex lock;
+	std::condition_variable wake;
+	bool running;
+	uint32_t wanted; // Stage to build next (0 = none)
+	uint32_t building;
+	uint32_t ready; // Stage of the built grid
+	CollisionGrid grid;
+	CollisionGrid spare; // Built outside the lock
+	std::vector<SDL_Rect> rects;
+	void Build(uint32_t stage);
+	void Work();
+public:
+	uint64_t hits; // Stage changes served from the built grid
+	uint64_t misses;
+
+	StagePrefetcher();
+	~StagePrefetcher();
+	void Start(Level* level, int width);
+	void Stop();
+	void Request(uint32_t stage);
+	bool Take(uint32_t stage, CollisionGrid &grid);
+};
+
+#endif
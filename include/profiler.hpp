@@ -0,0 +1,80 @@
+#ifndef __PROFILER_HPP
+#define __PROFILER_HPP
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <SDL2/SDL.h>
+
+// Zone events kept per thread (oldest are overwritten)
+#define PROFILER_BUFFER_SIZE 65536
+
+struct ProfileEvent {
+	const char* name;
+	uint64_t start;
+	uint64_t end;
+};
+
+struct ProfileTotal {
+	std::string name;
+	uint64_t ticks;
+	uint64_t count;
+};
+
+// Written only by the owning thread without locking, other threads read it once the owner stopped recording
+struct ProfileBuffer {
+	uint32_t thread;
+	std::atomic<uint64_t> count; // Events recorded (published after the event is written)
+	ProfileEvent events[PROFILER_BUFFER_SIZE];
+	uint64_t folded; // Events already summed into totals (before the buffer overwrites them)
+	std::map<const char*, ProfileTotal> totals;
+};
+
+class Profiler {
+private:
+	std::mutex lock;
+	std::vector<ProfileBuffer*> buffers;
+	ProfileBuffer* GetBuffer();
+public:
+	bool enabled;
+
+	Profiler();
+	~Profiler();
+	void Record(const char* name, uint64_t start, uint64_t end);
+
+	// Other threads must have stopped recording (worker threads are joined first)
+	std::vector<ProfileTotal> Totals();
+	bool Export(const char* path);
+};
+
+extern Profiler profiler;
+
+class ProfileZone {
+private:
+	const char* name;
+	uint64_t start;
+public:
+	ProfileZone(const char* name) {
+		this->name = name;
+		this->start = (profiler.enabled ? SDL_GetPerformanceCounter() : 0);
+	}
+	~ProfileZone() {
+		if(this->start != 0) {
+			profiler.Record(this->name, this->start, SDL_GetPerformanceCounter());
+		}
+	}
+};
+
+// Scoped timing zone (name must be a string literal)
+#ifndef NPROFILE
+	#define PROFILE_CONCAT2(a, b) a##b
+	#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+	#define PROFILE_SCOPE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#else
+	#define PROFILE_SCOPE(name)
+#endif
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef __REGISTRY_HPP
+#define __REGISTRY_HPP
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <cstdint>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#ifndef __EMSCRIPTEN__
+	#include <SDL2/SDL_mixer.h>
+#endif
+
+enum { // Used by ResourceRegistry
+	RESOURCE_TEXTURE, RESOURCE_FONT,
+	RESOURCE_SOUND, RESOURCE_MUSIC,
+	RESOURCE_TYPES
+};
+
+struct ResourceInfo {
+	int type;
+	size_t bytes;
+	std::string tag;
+};
+
+class ResourceRegistry {
+private:
+	std::mutex lock;
+	std::map<void*, ResourceInfo> live;
+public:
+	size_t count[RESOURCE_TYPES];
+	size_t bytes[RESOURCE_TYPES];
+	size_t peak[RESOURCE_TYPES];
+
+	ResourceRegistry();
+	void Add(void* ptr, int type, size_t bytes, std::string tag);
+	void Remove(void* ptr);
+	std::string Report();
+	std::string Leaks();
+};
+
+extern ResourceRegistry registry;
+
+// Unregister and free resources
+void DestroyResource(SDL_Texture* texture);
+void DestroyResource(TTF_Font* font);
+#ifndef __EMSCRIPTEN__
+	void DestroyResource(Mix_Chunk* chunk);
+	void DestroyResource(Mix_Music* music);
+#endif
+
+// Move-only owner of a registered resource
+template<typename T> class Resource {
+private:
+	T* ptr;
+public:
+	Resource() {
+		this->ptr = NULL;
+	}
+	explicit Resource(T* ptr) {
+		this->ptr = ptr;
+	}
+	Resource(Resource&& other) {
+		this->ptr = other.Release();
+	}
+	Resource& operator=(Resource&& other) {
+		if(this != &other) {
+			this->Reset(other.Release());
+		}
+		return *this;
+	}
+	Resource(const Resource&) = delete;
+	Resource& operator=(const Resource&) = delete;
+	~Resource() {
+		this->Reset();
+	}
+
+	void Reset(T* ptr = NULL) {
+		if(this->ptr != NULL && this->ptr != ptr) {
+			DestroyResource(this->ptr);
+		}
+		this->ptr = ptr;
+	}
+	T* Release() {
+		T* ptr = this->ptr;
+		this->ptr = NULL;
+		return ptr;
+	}
+	T* Get() const {
+		return this->ptr;
+	}
+	operator T*() const {
+		return this->ptr;
+	}
+};
+
+typedef Resource<SDL_Texture> Texture;
+typedef Resource<TTF_Font> Font;
+#ifndef __EMSCRIPTEN__
+	typedef Resource<Mix_Chunk> Sound;
+	typedef Resource<Mix_Music> Music;
+#endif
+
+#endif
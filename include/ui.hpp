@@ -0,0 +1,85 @@
+#ifndef __UI_HPP
+#define __UI_HPP
+
+#include <string>
+#include <vector>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include "engine.hpp"
+
+enum { // Used by Widget class
+	WIDGET_PANEL, WIDGET_IMAGE, WIDGET_LABEL,
+	WIDGET_BUTTON, WIDGET_TRACKBAR
+};
+
+// Trackbar thumb size and track height
+#define TRACKBAR_THUMB_W 9
+#define TRACKBAR_TRACK_H 5
+
+class Widget {
+private:
+	Texture cache;
+	bool dirty;
+	void Render(Engine* engine);
+public:
+	int type;
+	SDL_Rect bounds; // Relative to parent
+	SDL_Rect rect; // On screen
+	bool visible;
+	bool focused;
+	bool centered; // Center horizontally in parent
+	int value;
+	std::string text;
+	TTF_Font* font;
+	SDL_Texture* image;
+	int sprite; // Engine sprite ID (drawn instead of image when set)
+	SDL_Color textColor;
+	SDL_Color bgColor;
+	SDL_Color borderColor;
+	SDL_Color focusColor;
+	int borderSize;
+	Widget* parent;
+	std::vector<Widget*> children;
+
+	Widget(int type, SDL_Rect bounds);
+	~Widget();
+	Widget* Add(Widget* child);
+	void Layout();
+	void SetText(const std::string &text);
+	void SetFocus(bool focused);
+	void SetValue(int value);
+	void SetVisible(bool visible);
+	bool IsDirty();
+	Widget* HitTest(int x, int y);
+	bool OnThumb(int x);
+	int ValueAt(int x);
+	void Prepare(Engine* engine);
+	void Compose(Engine* engine);
+	void ReplaceFont(TTF_Font* from, TTF_Font* to);
+	void Free();
+};
+
+class UI {
+private:
+	Texture layer;
+public:
+	Widget root;
+	uint64_t composes;
+
+	UI(int w, int h);
+	Widget* Add(Widget* widget);
+	Widget* HitTest(int x, int y);
+	void Draw(Engine* engine);
+	void ReplaceFont(TTF_Font* from, TTF_Font* to);
+	void Free();
+};
+
+// Widget constructors
+Widget* CreateImage(SDL_Texture* image, SDL_Rect bounds);
+Widget* CreateImage(int sprite, SDL_Rect bounds);
+Widget* CreateLabel(TTF_Font* font, std::string text, SDL_Color color, SDL_Rect bounds);
+Widget* CreateButton(TTF_Font* font, std::string text, SDL_Rect bounds, SDL_Color textColor,
+	SDL_Color bgColor, SDL_Color borderColor, SDL_Color focusColor, int borderSize = 3);
+Widget* CreateTrackbar(SDL_Rect bounds, int value, SDL_Color trackColor, SDL_Color thumbColor, SDL_Color lineColor);
+
+#endif
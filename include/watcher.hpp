@@ -0,0 +1,34 @@
+#ifndef __WATCHER_HPP
+#define __WATCHER_HPP
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "loader.hpp"
+
+// Watches asset directories and loads changed files in the background (Linux only)
+class AssetWatcher {
+private:
+	int fd;
+	std::map<int, std::string> dirs; // Watch descriptor to directory
+	std::thread thread;
+	std::atomic<bool> running;
+	std::mutex lock;
+	std::deque<LoadJob*> ready;
+	void Work();
+public:
+	uint64_t reloads;
+
+	AssetWatcher();
+	~AssetWatcher();
+	bool Start(const std::vector<std::string> &dirs);
+	void Stop();
+	LoadJob* Next();
+	void Done(LoadJob* job);
+};
+
+#endif
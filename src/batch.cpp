@@ -0,0 +1,279 @@
+#include <cmath>
+#include <algorithm>
+#include "../include/batch.hpp"
+#include "../include/engine.hpp"
+#include "../include/profiler.hpp"
+
+SpriteBatch::SpriteBatch() {
+	this->sizeTexture = NULL;
+	this->sizeW = 0;
+	this->sizeH = 0;
+	this->drawCalls = 0;
+	this->drawVertices = 0;
+}
+
+BatchItem* SpriteBatch::AddItem(int type, SDL_Texture* texture, int layer, SDL_BlendMode blend) {
+	BatchItem item;
+	item.type = type;
+	item.layer = layer;
+	item.texture = texture;
+	item.blend = blend;
+	item.first = this->vertices.size();
+	item.flip = SDL_FLIP_NONE;
+	this->items.push_back(item);
+	return &this->items.back();
+}
+
+void SpriteBatch::AddVertex(float x, float y, SDL_Color color, float u, float v) {
+	BatchVertex vertex;
+	vertex.position = { x, y };
+	vertex.color = color;
+	vertex.tex_coord = { u, v };
+	this->vertices.push_back(vertex);
+}
+
+void SpriteBatch::AddQuad(SDL_Texture* texture, const SDL_Rect* src, const SDL_Rect* dst, SDL_Color color, SDL_RendererFlip flip, int layer, SDL_BlendMode blend) {
+	if(texture == NULL) return;
+
+	// Get texture size (for texture coordinates)
+	if(texture != this->sizeTexture) {
+		if(SDL_QueryTexture(texture, NULL, NULL, &this->sizeW, &this->sizeH) < 0) return;
+		this->sizeTexture = texture;
+	}
+
+	BatchItem* item = this->AddItem(BATCH_QUAD, texture, layer, blend);
+	item->src = (src != NULL ? *src : SDL_Rect { 0, 0, this->sizeW, this->sizeH });
+	item->dst = (dst != NULL ? *dst : SDL_Rect { 0, 0, item->src.w, item->src.h });
+	item->flip = flip;
+
+	// Texture coordinates (swapped when flipped)
+	float u1 = (float)item->src.x / this->sizeW, u2 = (float)(item->src.x + item->src.w) / this->sizeW;
+	float v1 = (float)item->src.y / this->sizeH, v2 = (float)(item->src.y + item->src.h) / this->sizeH;
+	if(flip & SDL_FLIP_HORIZONTAL) std::swap(u1, u2);
+	if(flip & SDL_FLIP_VERTICAL) std::swap(v1, v2);
+
+	float x1 = item->dst.x, y1 = item->dst.y, x2 = item->dst.x + item->dst.w, y2 = item->dst.y + item->dst.h;
+	this->AddVertex(x1, y1, color, u1, v1);
+	this->AddVertex(x2, y1, color, u2, v1);
+	this->AddVertex(x2, y2, color, u2, v2);
+	this->AddVertex(x1, y2, color, u1, v2);
+}
+
+void SpriteBatch::AddRect(const SDL_Rect* rect, SDL_Color color, int layer, SDL_BlendMode blend) {
+	BatchItem* item = this->AddItem(BATCH_RECT, NULL, layer, blend);
+	item->dst = *rect;
+
+	float x1 = rect->x, y1 = rect->y, x2 = rect->x + rect->w, y2 = rect->y + rect->h;
+	this->AddVertex(x1, y1, color);
+	this->AddVertex(x2, y1, color);
+	this->AddVertex(x2, y2, color);
+	this->AddVertex(x1, y2, color);
+}
+
+void SpriteBatch::AddLine(int x1, int y1, int x2, int y2, SDL_Color color, int layer, SDL_BlendMode blend) {
+	BatchItem* item = this->AddItem(BATCH_LINE, NULL, layer, blend);
+	item->dst = { x1, y1, x2, y2 };
+
+	// One pixel wide quad covering the line from pixel center to pixel center
+	float dx = x2 - x1, dy = y2 - y1;
+	float len = std::sqrt(dx * dx + dy * dy);
+	if(len > 0) {
+		dx = dx / len * 0.5f;
+		dy = dy / len * 0.5f;
+	} else {
+		dx = 0.5f;
+	}
+	float ax = x1 + 0.5f - dx, ay = y1 + 0.5f - dy;
+	float bx = x2 + 0.5f + dx, by = y2 + 0.5f + dy;
+	this->AddVertex(ax - dy, ay + dx, color);
+	this->AddVertex(bx - dy, by + dx, color);
+	this->AddVertex(bx + dy, by - dx, color);
+	this->AddVertex(ax + dy, ay - dx, color);
+}
+
+void SpriteBatch::AddTriangle(SDL_FPoint a, SDL_FPoint b, SDL_FPoint c, SDL_Color color, int layer, SDL_BlendMode blend) {
+	this->AddItem(BATCH_TRIANGLE, NULL, layer, blend);
+	this->AddVertex(a.x, a.y, color);
+	this->AddVertex(b.x, b.y, color);
+	this->AddVertex(c.x, c.y, color);
+}
+
+bool SpriteBatch::Empty() {
+	return this->items.empty();
+}
+
+void SpriteBatch::Forget(SDL_Texture* texture) {
+	// Texture is about to be destroyed (its address may be reused)
+	if(texture == this->sizeTexture) this->sizeTexture = NULL;
+}
+
+void SpriteBatch::Flush(Engine* engine) {
+	if(this->items.empty()) return;
+	PROFILE_SCOPE("FlushBatch");
+
+	// Order by layer, then group textures inside each layer
+	std::stable_sort(this->items.begin(), this->items.end(), [](const BatchItem &a, const BatchItem &b) {
+		return a.layer < b.layer;
+	});
+	this->Regroup();
+
+	// Adjacent items with the same texture and blend mode are submitted together
+	size_t first = 0;
+	for(size_t i = 1; i <= this->items.size(); i++) {
+		if(i == this->items.size() || this->items[i].layer != this->items[first].layer ||
+			this->items[i].texture != this->items[first].texture || this->items[i].blend != this->items[first].blend) {
+			this->Submit(engine, first, i);
+			first = i;
+		}
+	}
+
+	this->items.clear();
+	this->vertices.clear();
+}
+
+SDL_FRect SpriteBatch::Bounds(const BatchItem &item) {
+	// Triangles have 3 vertices, everything else 4
+	const BatchVertex* v = &this->vertices[item.first];
+	int count = (item.type == BATCH_TRIANGLE ? 3 : 4);
+	float x1 = v[0].position.x, y1 = v[0].position.y, x2 = x1, y2 = y1;
+	for(int i = 1; i < count; i++) {
+		x1 = std::min(x1, v[i].position.x);
+		y1 = std::min(y1, v[i].position.y);
+		x2 = std::max(x2, v[i].position.x);
+		y2 = std::max(y2, v[i].position.y);
+	}
+	return { x1, y1, x2 - x1, y2 - y1 };
+}
+
+void SpriteBatch::Regroup() {
+	// Move each item back into an earlier run with the same texture and blend mode,
+	// but only past runs it doesn't overlap (so what ends up on screen is unchanged)
+	this->runs.clear();
+	this->itemRuns.resize(this->items.size());
+	size_t layerFirst = 0;
+	for(size_t i = 0; i < this->items.size(); i++) {
+		const BatchItem &item = this->items[i];
+		if(i > 0 && item.layer != this->items[i - 1].layer) layerFirst = this->runs.size();
+		SDL_FRect bounds = this->Bounds(item);
+
+		size_t found = this->runs.size();
+		size_t stop = (this->runs.size() - layerFirst > BATCH_LOOKBACK ? this->runs.size() - BATCH_LOOKBACK : layerFirst);
+		for(size_t j = this->runs.size(); j > stop; j--) {
+			BatchRun &run = this->runs[j - 1];
+			if(run.texture == item.texture && run.blend == item.blend) {
+				found = j - 1;
+				break;
+			}
+			if(bounds.x < run.bounds.x + run.bounds.w && run.bounds.x < bounds.x + bounds.w &&
+				bounds.y < run.bounds.y + run.bounds.h && run.bounds.y < bounds.y + bounds.h) {
+				break;
+			}
+		}
+
+		if(found == this->runs.size()) {
+			this->runs.push_back({ item.texture, item.blend, bounds, 0 });
+		} else {
+			SDL_FRect &r = this->runs[found].bounds;
+			float x2 = std::max(r.x + r.w, bounds.x + bounds.w), y2 = std::max(r.y + r.h, bounds.y + bounds.h);
+			r.x = std::min(r.x, bounds.x);
+			r.y = std::min(r.y, bounds.y);
+			r.w = x2 - r.x;
+			r.h = y2 - r.y;
+		}
+		this->runs[found].count++;
+		this->itemRuns[i] = found;
+	}
+	if(this->runs.size() == this->items.size()) return;
+
+	// Lay items out run by run (keeping their order inside a run)
+	uint32_t offset = 0;
+	for(BatchRun &run : this->runs) {
+		uint32_t count = run.count;
+		run.count = offset;
+		offset += count;
+	}
+	this->sorted.resize(this->items.size());
+	for(size_t i = 0; i < this->items.size(); i++) {
+		this->sorted[this->runs[this->itemRuns[i]].count++] = this->items[i];
+	}
+	this->items.swap(this->sorted);
+}
+
+void SpriteBatch::Submit(Engine* engine, size_t first, size_t last) {
+	// Renderer state goes through the engine (skipped when it's already set)
+	SDL_Texture* texture = this->items[first].texture;
+	SDL_BlendMode blend = this->items[first].blend;
+	if(texture != NULL) {
+		SDL_SetTextureBlendMode(texture, blend);
+	} else {
+		engine->SetBlendMode(blend);
+	}
+
+	#ifdef BATCH_GEOMETRY
+		// Build one vertex and index list for the whole group
+		this->groupVertices.clear();
+		this->groupIndices.clear();
+		for(size_t i = first; i < last; i++) {
+			const BatchItem &item = this->items[i];
+			int base = this->groupVertices.size();
+			int count = (item.type == BATCH_TRIANGLE ? 3 : 4);
+			this->groupVertices.insert(this->groupVertices.end(), this->vertices.begin() + item.first, this->vertices.begin() + item.first + count);
+			if(count == 3) {
+				this->groupIndices.insert(this->groupIndices.end(), { base, base + 1, base + 2 });
+			} else {
+				this->groupIndices.insert(this->groupIndices.end(), { base, base + 1, base + 2, base + 2, base + 3, base });
+			}
+		}
+		SDL_RenderGeometry(engine->r, texture, this->groupVertices.data(), this->groupVertices.size(), this->groupIndices.data(), this->groupIndices.size());
+		this->drawCalls++;
+		this->drawVertices += this->groupVertices.size();
+	#else
+		// Older SDL draws items one by one
+		for(size_t i = first; i < last; i++) {
+			this->SubmitFallback(engine, this->items[i]);
+		}
+	#endif
+}
+
+void SpriteBatch::SubmitFallback(Engine* engine, const BatchItem &item) {
+	SDL_Renderer* r = engine->r;
+	const BatchVertex* v = &this->vertices[item.first];
+	if(item.type == BATCH_QUAD) {
+		SDL_SetTextureColorMod(item.texture, v->color.r, v->color.g, v->color.b);
+		SDL_SetTextureAlphaMod(item.texture, v->color.a);
+		SDL_RenderCopyEx(r, item.texture, &item.src, &item.dst, 0, NULL, item.flip);
+		SDL_SetTextureColorMod(item.texture, 255, 255, 255);
+		SDL_SetTextureAlphaMod(item.texture, 255);
+		this->drawVertices += 4;
+	} else {
+		engine->SetColor(v->color);
+		if(item.type == BATCH_RECT) {
+			SDL_RenderFillRect(r, &item.dst);
+			this->drawVertices += 4;
+		} else if(item.type == BATCH_LINE) {
+			SDL_RenderDrawLine(r, item.dst.x, item.dst.y, item.dst.w, item.dst.h);
+			this->drawVertices += 2;
+		} else {
+			// Fill triangle with horizontal spans
+			std::vector<SDL_Rect> spans;
+			float minY = std::min(v[0].position.y, std::min(v[1].position.y, v[2].position.y));
+			float maxY = std::max(v[0].position.y, std::max(v[1].position.y, v[2].position.y));
+			for(int y = std::ceil(minY - 0.5f); y + 0.5f <= maxY; y++) {
+				float cy = y + 0.5f, x1 = 1e9f, x2 = -1e9f;
+				for(int e = 0; e < 3; e++) {
+					const SDL_FPoint &a = v[e].position, &b = v[(e + 1) % 3].position;
+					if((a.y <= cy && b.y > cy) || (b.y <= cy && a.y > cy)) {
+						float x = a.x + (cy - a.y) * (b.x - a.x) / (b.y - a.y);
+						x1 = std::min(x1, x);
+						x2 = std::max(x2, x);
+					}
+				}
+				int sx = std::ceil(x1 - 0.5f), ex = std::ceil(x2 - 0.5f);
+				if(ex > sx) spans.push_back({ sx, y, ex - sx, 1 });
+			}
+			SDL_RenderFillRects(r, spans.data(), spans.size());
+			this->drawVertices += 3;
+		}
+	}
+	this->drawCalls++;
+}
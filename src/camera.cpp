@@ -0,0 +1,40 @@
+#include <cmath>
+#include "../include/camera.hpp"
+
+Camera::Camera(int w, int h) {
+	this->x = 0;
+	this->w = w;
+	this->h = h;
+	this->chunkW = w;
+	this->chunks = 0;
+	this->margin = CAMERA_MARGIN;
+}
+
+void Camera::SetWorld(uint32_t chunks, int chunkW) {
+	this->chunks = chunks;
+	this->chunkW = chunkW;
+	this->Follow(this->x + this->w / 2.0);
+}
+
+void Camera::Follow(double x) {
+	// Center on the point, world edges stop the camera
+	double right = (double)this->chunks * this->chunkW - this->w;
+	this->x = x - this->w / 2.0;
+	if(this->x > right) this->x = right;
+	if(this->x < 0) this->x = 0;
+}
+
+bool Camera::Visible(uint32_t &first, uint32_t &last, uint32_t margin) {
+	// Chunks intersecting the viewport (widened by margin chunks on each side)
+	if(this->chunks == 0 || this->chunkW <= 0) return false;
+	int64_t left = (int64_t)std::floor(this->x / this->chunkW) - margin;
+	int64_t right = (int64_t)std::ceil((this->x + this->w) / this->chunkW) - 1 + margin;
+	first = (left < 0 ? 0 : left);
+	last = (right >= this->chunks ? this->chunks - 1 : right);
+	return first <= last;
+}
+
+bool Camera::IsNear(uint32_t chunk) {
+	uint32_t first, last;
+	return this->Visible(first, last, this->margin) && chunk >= first && chunk <= last;
+}
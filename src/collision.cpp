@@ -0,0 +1,211 @@
+#include <cmath>
+#include <algorithm>
+#include "../include/collision.hpp"
+
+CollisionGrid::CollisionGrid() {
+	this->cell = COLLISION_CELL;
+	this->originX = 0;
+	this->originY = 0;
+	this->cols = 0;
+	this->rows = 0;
+	this->mark = 0;
+	this->queries = 0;
+	this->tests = 0;
+}
+
+void CollisionGrid::Build(const SDL_Rect* rects, size_t count, int cell) {
+	this->cell = (cell > 0 ? cell : COLLISION_CELL);
+	this->rects.assign(rects, rects + count);
+	this->marks.assign(count, 0);
+	this->mark = 0;
+	this->cellStart.clear();
+	this->cellItems.clear();
+	this->cols = 0;
+	this->rows = 0;
+	if(count == 0) return;
+
+	// Grid covers bounding box of all rectangles (aligned to cell size)
+	int minX = rects[0].x, minY = rects[0].y, maxX = rects[0].x + rects[0].w, maxY = rects[0].y + rects[0].h;
+	for(size_t i = 1; i < count; i++) {
+		minX = std::min(minX, rects[i].x);
+		minY = std::min(minY, rects[i].y);
+		maxX = std::max(maxX, rects[i].x + rects[i].w);
+		maxY = std::max(maxY, rects[i].y + rects[i].h);
+	}
+	this->originX = (int)std::floor((double)minX / this->cell) * this->cell;
+	this->originY = (int)std::floor((double)minY / this->cell) * this->cell;
+	this->cols = std::max(1, (maxX - this->originX + this->cell - 1) / this->cell);
+	this->rows = std::max(1, (maxY - this->originY + this->cell - 1) / this->cell);
+
+	// Count items per cell, then place them (every cell's items end up next to each other)
+	this->cellStart.assign((size_t)this->cols * this->rows + 1, 0);
+	for(int pass = 0; pass < 2; pass++) {
+		for(size_t i = 0; i < count; i++) {
+			const SDL_Rect &r = rects[i];
+			int x1 = (r.x - this->originX) / this->cell, x2 = (r.x + std::max(r.w, 1) - 1 - this->originX) / this->cell;
+			int y1 = (r.y - this->originY) / this->cell, y2 = (r.y + std::max(r.h, 1) - 1 - this->originY) / this->cell;
+			for(int y = y1; y <= y2; y++) {
+				for(int x = x1; x <= x2; x++) {
+					size_t index = (size_t)y * this->cols + x;
+					if(pass == 0) {
+						this->cellStart[index + 1]++;
+					} else {
+						this->cellItems[this->cellStart[index]++] = i;
+					}
+				}
+			}
+		}
+		if(pass == 0) {
+			for(size_t c = 1; c < this->cellStart.size(); c++) {
+				this->cellStart[c] += this->cellStart[c - 1];
+			}
+			this->cellItems.resize(this->cellStart.back());
+		} else {
+			// Filling moved every start to the next cell
+			for(size_t c = this->cellStart.size() - 1; c > 0; c--) {
+				this->cellStart[c] = this->cellStart[c - 1];
+			}
+			this->cellStart[0] = 0;
+		}
+	}
+}
+
+size_t CollisionGrid::Count() {
+	return this->rects.size();
+}
+
+size_t CollisionGrid::Query(const SDL_Rect &area, std::vector<uint32_t> &out) {
+	this->queries++;
+	out.clear();
+	if(this->rects.empty()) return 0;
+
+	// Cells touched by the area (clamped to the grid)
+	int x1 = (int)std::floor((double)(area.x - this->originX) / this->cell);
+	int y1 = (int)std::floor((double)(area.y - this->originY) / this->cell);
+	int x2 = (int)std::floor((double)(area.x + area.w - 1 - this->originX) / this->cell);
+	int y2 = (int)std::floor((double)(area.y + area.h - 1 - this->originY) / this->cell);
+	x1 = std::max(x1, 0);
+	y1 = std::max(y1, 0);
+	x2 = std::min(x2, this->cols - 1);
+	y2 = std::min(y2, this->rows - 1);
+	if(x1 > x2 || y1 > y2) return 0;
+
+	// Rectangles spanning several cells are returned once
+	if(++this->mark == 0) {
+		std::fill(this->marks.begin(), this->marks.end(), 0);
+		this->mark = 1;
+	}
+	for(int y = y1; y <= y2; y++) {
+		for(int x = x1; x <= x2; x++) {
+			size_t index = (size_t)y * this->cols + x;
+			for(uint32_t i = this->cellStart[index]; i < this->cellStart[index + 1]; i++) {
+				uint32_t item = this->cellItems[i];
+				if(this->marks[item] == this->mark) continue;
+				this->marks[item] = this->mark;
+				this->tests++;
+				const SDL_Rect &r = this->rects[item];
+				if(area.x < r.x + r.w && area.x + area.w > r.x && area.y < r.y + r.h && area.y + area.h > r.y) {
+					out.push_back(item);
+				}
+			}
+		}
+	}
+	return out.size();
+}
+
+static double SweepTime(double x, double y, int w, int h, double dx, double dy, const SDL_Rect &r, int &normal) {
+	// Entry and exit times on each axis (box already overlapping on an axis that doesn't move stays overlapping)
+	double entryX, exitX, entryY, exitY;
+	if(dx > 0) {
+		entryX = (r.x - (x + w)) / dx;
+		exitX = (r.x + r.w - x) / dx;
+	} else if(dx < 0) {
+		entryX = (r.x + r.w - x) / dx;
+		exitX = (r.x - (x + w)) / dx;
+	} else if(x < r.x + r.w && x + w > r.x) {
+		entryX = -INFINITY;
+		exitX = INFINITY;
+	} else {
+		return 1;
+	}
+	if(dy > 0) {
+		entryY = (r.y - (y + h)) / dy;
+		exitY = (r.y + r.h - y) / dy;
+	} else if(dy < 0) {
+		entryY = (r.y + r.h - y) / dy;
+		exitY = (r.y - (y + h)) / dy;
+	} else if(y < r.y + r.h && y + h > r.y) {
+		entryY = -INFINITY;
+		exitY = INFINITY;
+	} else {
+		return 1;
+	}
+
+	// Rectangles the box already overlaps or only grazes are not hit
+	double entry = std::max(entryX, entryY), exit = std::min(exitX, exitY);
+	if(entry >= exit || entry < -1e-9 || entry >= 1) return 1;
+	if(entryX > entryY) {
+		normal = (dx > 0 ? CONTACT_RIGHT : CONTACT_LEFT);
+	} else {
+		normal = (dy > 0 ? CONTACT_GROUND : CONTACT_CEILING);
+	}
+	return std::max(entry, 0.0);
+}
+
+int CollisionGrid::Move(double &x, double &y, int w, int h, double dx, double dy) {
+	// Box stops at the first rectangle in its path however far it moves (no tunnelling through thin platforms)
+	int contacts = 0;
+	bool down = (dy >= 0);
+	for(int pass = 0; pass < COLLISION_PASSES && (dx != 0 || dy != 0); pass++) {
+		SDL_Rect area = { (int)std::floor(std::min(x, x + dx)), (int)std::floor(std::min(y, y + dy)),
+			(int)std::ceil(std::fabs(dx)) + w + 1, (int)std::ceil(std::fabs(dy)) + h + 1 };
+		this->Query(area, this->found);
+
+		double first = 1;
+		int normal = 0;
+		const SDL_Rect* hit = NULL;
+		for(auto item: this->found) {
+			int side = 0;
+			double time = SweepTime(x, y, w, h, dx, dy, this->rects[item], side);
+			if(time < first) {
+				first = time;
+				normal = side;
+				hit = &this->rects[item];
+			}
+		}
+		if(hit == NULL) {
+			x += dx;
+			y += dy;
+			break;
+		}
+
+		// Snap to the surface exactly (rounding could leave box inside it), the rest slides along it
+		contacts |= normal;
+		double rest = 1 - first;
+		if(normal == CONTACT_RIGHT || normal == CONTACT_LEFT) {
+			x = (normal == CONTACT_RIGHT ? hit->x - w : hit->x + hit->w);
+			y += dy * first;
+			dx = 0;
+			dy *= rest;
+		} else {
+			x += dx * first;
+			y = (normal == CONTACT_GROUND ? hit->y - h : hit->y + hit->h);
+			dx *= rest;
+			dy = 0;
+		}
+	}
+
+	// Standing on a rectangle counts as ground contact
+	if(down && !(contacts & CONTACT_GROUND)) {
+		SDL_Rect below = { (int)std::floor(x), (int)std::floor(y) + h - 1, w + 1, 2 };
+		this->Query(below, this->found);
+		for(auto item: this->found) {
+			const SDL_Rect &r = this->rects[item];
+			if(std::fabs(y + h - r.y) < 0.001 && x < r.x + r.w && x + w > r.x) {
+				contacts |= CONTACT_GROUND;
+				break;
+			}
+		}
+	}
+	return contacts;
+}
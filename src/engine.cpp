@@ -1,4 +1,26 @@
+#include <ctime>
+#include <sstream>
 #include "../include/engine.hpp"
+#include "../include/profiler.hpp"
+#ifdef _WIN32
+	#include <windows.h>
+#endif
+
+static uint64_t ThreadCpuTime() {
+	// CPU time used by the calling thread (nanoseconds)
+	#if defined(_WIN32)
+		FILETIME created, exited, kernel, user;
+		if(!GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user)) return 0;
+		return ((((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime) +
+			(((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime)) * 100;
+	#elif defined(CLOCK_THREAD_CPUTIME_ID)
+		timespec ts;
+		if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0) return 0;
+		return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	#else
+		return 0;
+	#endif
+}
 
 Engine::Engine(const char* title, int x, int y, int w, int h) {
 	this->title = title;
@@ -6,19 +28,70 @@ Engine::Engine(const char* title, int x, int y, int w, int h) {
 	this->wy = y;
 	this->ww = w;
 	this->wh = h;
+	this->vsync = false;
+	this->headless = false;
+	this->w = NULL;
+	this->r = NULL;
+	this->s = NULL;
+	this->textCacheBudget = TEXT_CACHE_BUDGET;
+	this->textCacheBytes = 0;
+	this->textHits = 0;
+	this->textMisses = 0;
+	this->textEvictions = 0;
+	this->drawCalls = 0;
+	this->drawVertices = 0;
+	this->frameDrawCalls = 0;
+	this->frameDrawVertices = 0;
+	this->stateCalls = 0;
+	this->stateSkips = 0;
+	this->frameStateCalls = 0;
+	this->frameStateSkips = 0;
+	this->totalStateCalls = 0;
+	this->totalStateSkips = 0;
+	this->flushing = false;
+	this->ResetState();
+	#ifndef __EMSCRIPTEN__
+		this->audioFrames = 0;
+		this->audioCpu = 0;
+		this->audioLastCpu = 0;
+		this->audioRate = 0;
+		this->audioSamples = 0;
+		this->audioFrameSize = 0;
+		this->audioLastCounter = 0;
+		this->audioCallbacks = 0;
+		this->audioUnderruns = 0;
+		this->audioMaxCpu = 0;
+		this->voiceSteals = 0;
+		this->voiceDrops = 0;
+	#endif
 }
 
 Engine::~Engine() {
+	this->ClearTextCache();
+	this->FreeSprites();
+	this->ClearPreloaded();
 	SDL_DestroyRenderer(this->r);
-	SDL_DestroyWindow(this->w);
+	if(this->w != NULL) {
+		SDL_DestroyWindow(this->w);
+	}
+	if(this->s != NULL) {
+		SDL_FreeSurface(this->s);
+	}
 	#ifndef __EMSCRIPTEN__
-		Mix_CloseAudio();
+		if(this->audioSamples != 0) {
+			Mix_SetPostMix(NULL, NULL);
+			Mix_CloseAudio();
+		}
 	#endif
 	TTF_Quit();
 	SDL_Quit();
 }
 
 bool Engine::Init() {
+	if(this->headless) {
+		return this->InitHeadless();
+	}
+
 	// Init SDL
 	if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
 		this->lastError = "Can't init SDL (" + std::string(SDL_GetError()) + ")";
@@ -45,7 +118,7 @@ bool Engine::Init() {
 	#endif
 
 	// Create renderer
-	this->r = SDL_CreateRenderer(this->w, -1, SDL_RENDERER_ACCELERATED);
+	this->r = SDL_CreateRenderer(this->w, -1, SDL_RENDERER_ACCELERATED | (this->vsync ? SDL_RENDERER_PRESENTVSYNC : 0));
 	if(this->r == NULL) {
 		SDL_DestroyWindow(this->w);
 		SDL_Quit();
@@ -54,6 +127,7 @@ bool Engine::Init() {
 	}
 
 	// Set window background color
+	this->ResetState();
 	if(this->SetColor({ 255, 255, 255, 255 }) < 0) {
 		SDL_DestroyRenderer(this->r);
 		SDL_DestroyWindow(this->w);
@@ -71,50 +145,271 @@ bool Engine::Init() {
 		return false;
 	}
 
-	#ifndef __EMSCRIPTEN__
-		// Init sound engine
-		if(Mix_OpenAudio(22050, MIX_DEFAULT_FORMAT, 2, 4096) < 0) {
-			SDL_DestroyRenderer(this->r);
-			SDL_DestroyWindow(this->w);
-			TTF_Quit();
-			SDL_Quit();
+	return true;
+}
+
+#ifndef __EMSCRIPTEN__
+	bool Engine::InitAudio(int rate, int samples, int voices) {
+		// Init sound engine (buffer of samples / rate seconds, e.g. 512 / 48000 = 10.7 ms)
+		if(Mix_OpenAudio(rate, MIX_DEFAULT_FORMAT, 2, samples) < 0) {
 			this->lastError = "Can't init sound engine (" + std::string(Mix_GetError()) + ")";
 			return false;
 		}
-	#endif
+		this->audioSamples = samples;
+
+		// Sound effects play on a fixed pool of channels
+		if(voices < 1) voices = 1;
+		Mix_AllocateChannels(voices);
+		this->voicePriority.assign(voices, 0);
+		this->voiceStart.assign(voices, 0);
+
+		// Measure audio thread work (music decoding and mixing)
+		uint16_t format;
+		int channels;
+		if(Mix_QuerySpec(&this->audioRate, &format, &channels) != 0) {
+			this->audioFrameSize = SDL_AUDIO_BITSIZE(format) / 8 * channels;
+			Mix_SetPostMix(PostMix, this);
+		}
+		return true;
+	}
+
+	int Engine::PlaySound(Mix_Chunk* sound, int priority, uint8_t volume, int loops) {
+		if(sound == NULL || this->voicePriority.empty()) return -1;
+
+		// Use a free voice or steal the one with the lowest priority (oldest first)
+		int voice = -1;
+		for(int i = 0; i < (int)this->voicePriority.size(); i++) {
+			if(!Mix_Playing(i)) {
+				voice = i;
+				break;
+			}
+			if(this->voicePriority[i] <= priority && (voice < 0 || this->voicePriority[i] < this->voicePriority[voice] ||
+				(this->voicePriority[i] == this->voicePriority[voice] && this->voiceStart[i] < this->voiceStart[voice]))) {
+				voice = i;
+			}
+		}
+		if(voice < 0) {
+			this->voiceDrops++;
+			return -1;
+		}
+		if(Mix_Playing(voice)) {
+			Mix_HaltChannel(voice);
+			this->voiceSteals++;
+		}
+
+		Mix_Volume(voice, volume / 100.0 * MIX_MAX_VOLUME);
+		if(Mix_PlayChannel(voice, sound, loops) < 0) return -1;
+		this->voicePriority[voice] = priority;
+		this->voiceStart[voice] = SDL_GetTicks();
+		return voice;
+	}
+
+	void Engine::StopSounds() {
+		if(!this->voicePriority.empty()) {
+			Mix_HaltChannel(-1);
+		}
+	}
+#endif
+
+bool Engine::InitHeadless() {
+	// Init SDL (without video and audio)
+	if(SDL_Init(SDL_INIT_TIMER | SDL_INIT_EVENTS) < 0) {
+		this->lastError = "Can't init SDL (" + std::string(SDL_GetError()) + ")";
+		return false;
+	}
+
+	// Create offscreen surface
+	this->s = SDL_CreateRGBSurfaceWithFormat(0, this->ww, this->wh, 32, SDL_PIXELFORMAT_RGBA8888);
+	if(this->s == NULL) {
+		SDL_Quit();
+		this->lastError = "Can't create offscreen surface (" + std::string(SDL_GetError()) + ")";
+		return false;
+	}
+
+	// Create software renderer
+	this->r = SDL_CreateSoftwareRenderer(this->s);
+	if(this->r == NULL) {
+		SDL_FreeSurface(this->s);
+		SDL_Quit();
+		this->lastError = "Can't create renderer (" + std::string(SDL_GetError()) + ")";
+		return false;
+	}
+
+	// Set background color
+	this->ResetState();
+	if(this->SetColor({ 255, 255, 255, 255 }) < 0) {
+		SDL_DestroyRenderer(this->r);
+		SDL_FreeSurface(this->s);
+		SDL_Quit();
+		this->lastError = "Can't set background color (" + std::string(SDL_GetError()) + ")";
+		return false;
+	}
+
+	// Init font engine
+	if(TTF_Init() < 0) {
+		SDL_DestroyRenderer(this->r);
+		SDL_FreeSurface(this->s);
+		SDL_Quit();
+		this->lastError = "Can't init font engine (" + std::string(TTF_GetError()) + ")";
+		return false;
+	}
 
 	return true;
 }
 
 void Engine::ShowWindow(bool show) {
-	(show ? SDL_ShowWindow : SDL_HideWindow)(this->w);
+	if(this->w != NULL) {
+		(show ? SDL_ShowWindow : SDL_HideWindow)(this->w);
+	}
 }
 
 void Engine::RaiseWindow() {
-	SDL_RaiseWindow(this->w);
+	if(this->w != NULL) {
+		SDL_RaiseWindow(this->w);
+	}
+}
+
+void Engine::ResetState() {
+	this->colorValid = false;
+	this->blendValid = false;
+	this->targetValid = false;
+	this->clipValid = false;
+	this->viewportValid = false;
+}
+
+bool Engine::StateChanged(bool changed) {
+	// Count SDL state calls and the ones skipped as redundant
+	if(changed) {
+		this->stateCalls++;
+	} else {
+		this->stateSkips++;
+	}
+	return changed;
 }
 
 int Engine::SetColor(SDL_Color color) {
-	return SDL_SetRenderDrawColor(this->r, color.r, color.g, color.b, color.a);
+	if(!this->StateChanged(!this->colorValid || color.r != this->color.r || color.g != this->color.g ||
+		color.b != this->color.b || color.a != this->color.a)) {
+		return 0;
+	}
+	this->FlushBatch();
+	int result = SDL_SetRenderDrawColor(this->r, color.r, color.g, color.b, color.a);
+	this->color = color;
+	this->colorValid = (result == 0);
+	return result;
+}
+
+int Engine::SetBlendMode(SDL_BlendMode mode) {
+	if(!this->StateChanged(!this->blendValid || mode != this->blendMode)) {
+		return 0;
+	}
+	this->FlushBatch();
+	int result = SDL_SetRenderDrawBlendMode(this->r, mode);
+	this->blendMode = mode;
+	this->blendValid = (result == 0);
+	return result;
 }
 
 int Engine::SetTarget(SDL_Texture* target) {
-	return SDL_SetRenderTarget(this->r, target);
+	if(!this->StateChanged(!this->targetValid || target != this->target)) {
+		return 0;
+	}
+	this->FlushBatch();
+	int result = SDL_SetRenderTarget(this->r, target);
+	this->target = target;
+	this->targetValid = (result == 0);
+
+	// SDL resets viewport and clip rect with the target
+	this->clipValid = false;
+	this->viewportValid = false;
+	return result;
+}
+
+int Engine::SetClip(const SDL_Rect* rect) {
+	SDL_Rect clip = (rect != NULL ? *rect : SDL_Rect { 0, 0, 0, 0 });
+	if(!this->StateChanged(!this->clipValid || clip.x != this->clip.x || clip.y != this->clip.y ||
+		clip.w != this->clip.w || clip.h != this->clip.h)) {
+		return 0;
+	}
+	this->FlushBatch();
+	int result = SDL_RenderSetClipRect(this->r, rect);
+	this->clip = clip;
+	this->clipValid = (result == 0);
+	return result;
+}
+
+int Engine::SetViewport(const SDL_Rect* rect) {
+	SDL_Rect viewport = (rect != NULL ? *rect : SDL_Rect { 0, 0, 0, 0 });
+	if(!this->StateChanged(!this->viewportValid || viewport.x != this->viewport.x || viewport.y != this->viewport.y ||
+		viewport.w != this->viewport.w || viewport.h != this->viewport.h)) {
+		return 0;
+	}
+	this->FlushBatch();
+	int result = SDL_RenderSetViewport(this->r, rect);
+	this->viewport = viewport;
+	this->viewportValid = (result == 0);
+	return result;
+}
+
+std::string Engine::StateReport() {
+	uint64_t total = this->totalStateCalls + this->totalStateSkips;
+	return std::to_string(this->totalStateCalls) + " state calls, " + std::to_string(this->totalStateSkips) + " skipped (" +
+		std::to_string(total > 0 ? this->totalStateSkips * 100 / total : 0) + "% redundant)";
 }
 
 int Engine::Clear() {
+	this->FlushBatch();
 	return SDL_RenderClear(this->r);
 }
 
 void Engine::Present() {
+	PROFILE_SCOPE("Present");
+	this->FlushBatch();
 	SDL_RenderPresent(this->r);
+
+	// Keep statistics of the presented frame
+	this->frameDrawCalls = this->drawCalls + this->batch.drawCalls;
+	this->frameDrawVertices = this->drawVertices + this->batch.drawVertices;
+	this->drawCalls = 0;
+	this->drawVertices = 0;
+	this->batch.drawCalls = 0;
+	this->batch.drawVertices = 0;
+
+	this->frameStateCalls = this->stateCalls;
+	this->frameStateSkips = this->stateSkips;
+	this->totalStateCalls += this->stateCalls;
+	this->totalStateSkips += this->stateSkips;
+	this->stateCalls = 0;
+	this->stateSkips = 0;
+}
+
+void Engine::FlushBatch() {
+	// Batch changes draw color and blend mode through the state cache (which must not flush again)
+	if(!this->flushing && !this->batch.Empty()) {
+		this->flushing = true;
+		this->batch.Flush(this);
+		this->flushing = false;
+	}
 }
 
 int Engine::DrawLine(int x, int y, int w, int h) {
+	this->FlushBatch();
+	this->drawCalls++;
+	this->drawVertices += 2;
 	return SDL_RenderDrawLine(this->r, x, y, x + w - 1, y + h - 1);
 }
 
+int Engine::FillRect(const SDL_Rect* rect) {
+	this->FlushBatch();
+	this->drawCalls++;
+	this->drawVertices += 4;
+	return SDL_RenderFillRect(this->r, rect);
+}
+
 int Engine::Draw(SDL_Texture* texture, const SDL_Rect* srcrect, const SDL_Rect* dstrect, const double angle, const SDL_Point* center, const SDL_RendererFlip flip) {
+	this->FlushBatch();
+	this->drawCalls++;
+	this->drawVertices += 4;
 	return SDL_RenderCopyEx(this->r, texture, srcrect, dstrect, angle, center, flip);
 }
 
@@ -122,11 +417,14 @@ int Engine::QueryTexture(SDL_Texture* txt, SDL_Rect* rect, uint32_t* format, int
 	return SDL_QueryTexture(txt, format, access, &rect->w, &rect->h);
 }
 
-SDL_Texture* Engine::CreateTexture(int w, int h, int access) {
-	return SDL_CreateTexture(this->r, SDL_PIXELFORMAT_RGBA8888, access, w, h);
+SDL_Texture* Engine::CreateTexture(int w, int h, int access, const char* tag) {
+	SDL_Texture* out = SDL_CreateTexture(this->r, SDL_PIXELFORMAT_RGBA8888, access, w, h);
+	registry.Add(out, RESOURCE_TEXTURE, (size_t)w * h * 4, tag);
+	return out;
 }
 
 SDL_Texture* Engine::ConnectTextures(SDL_Texture* txt1, SDL_Texture* txt2, int method, bool destroy) {
+	PROFILE_SCOPE("ConnectTextures");
 	if(txt1 == NULL || txt2 == NULL) return NULL;
 
 	SDL_Rect r1;
@@ -158,7 +456,7 @@ SDL_Texture* Engine::ConnectTextures(SDL_Texture* txt1, SDL_Texture* txt2, int m
 			break;
 	}
 
-	SDL_Texture* target = this->CreateTexture(w, h, SDL_TEXTUREACCESS_TARGET);
+	SDL_Texture* target = this->CreateTexture(w, h, SDL_TEXTUREACCESS_TARGET, "ConnectTextures");
 	if(target == NULL) return NULL;
 	this->SetTarget(target);
 	this->Clear();
@@ -212,62 +510,557 @@ SDL_Texture* Engine::ConnectTextures(SDL_Texture* txt1, SDL_Texture* txt2, int m
 
 	this->SetTarget(NULL);
 	if(destroy) {
-		SDL_DestroyTexture(txt1);
-		SDL_DestroyTexture(txt2);
+		DestroyResource(txt1);
+		DestroyResource(txt2);
 	}
 	return target;
 }
 
-SDL_Texture* Engine::SurfaceToTexture(SDL_Surface* surface) {
+SDL_Texture* Engine::SurfaceToTexture(SDL_Surface* surface, const char* tag) {
 	SDL_Texture* out = SDL_CreateTextureFromSurface(this->r, surface);
 	if(out != NULL) {
+		registry.Add(out, RESOURCE_TEXTURE, (size_t)surface->w * surface->h * 4, tag);
 		SDL_FreeSurface(surface);
 		surface = NULL;
 	}
 	return out;
 }
 
+bool Engine::OpenPack(const char* path) {
+	return this->pack.Open(path);
+}
+
+void Engine::Preload(LoadJob* job) {
+	PROFILE_SCOPE("Preload");
+	if(job == NULL || job->failed) return;
+
+	// Only the upload is done here, decoding was done by the loader
+	if(job->type == LOAD_IMAGE) {
+		SDL_Texture* texture = this->SurfaceToTexture(job->surface, job->path.c_str());
+		if(texture != NULL) {
+			this->preloadedTextures[job->path] = texture;
+		} else {
+			SDL_FreeSurface(job->surface);
+		}
+		job->surface = NULL;
+	} else if(job->type == LOAD_FILE) {
+		this->preloadedFiles[job->path].swap(job->data);
+	}
+	#ifndef __EMSCRIPTEN__
+		else if(job->type == LOAD_SOUND) {
+			registry.Add(job->sound, RESOURCE_SOUND, job->sound->alen, job->path);
+			this->preloadedSounds[job->path] = job->sound;
+			job->sound = NULL;
+		}
+	#endif
+}
+
+void Engine::ClearPreloaded() {
+	// Destroy assets that were never taken
+	for(auto &it: this->preloadedTextures) {
+		DestroyResource(it.second);
+	}
+	this->preloadedTextures.clear();
+	this->preloadedFiles.clear();
+	#ifndef __EMSCRIPTEN__
+		for(auto &it: this->preloadedSounds) {
+			DestroyResource(it.second);
+		}
+		this->preloadedSounds.clear();
+	#endif
+}
+
+std::string Engine::ReadText(const char* path) {
+	// Read whole file from the asset pack or from disk
+	SDL_RWops* data = this->pack.Read(path);
+	if(data == NULL) data = SDL_RWFromFile(path, "rb");
+	if(data == NULL) return "";
+	Sint64 size = SDL_RWsize(data);
+	std::string out(size > 0 ? size : 0, '\0');
+	if(size > 0 && SDL_RWread(data, &out[0], size, 1) != 1) {
+		out.clear();
+	}
+	SDL_RWclose(data);
+	return out;
+}
+
 SDL_Texture* Engine::LoadTexture(const char* path) {
+	PROFILE_SCOPE("LoadTexture");
+	auto preloaded = this->preloadedTextures.find(path);
+	if(preloaded != this->preloadedTextures.end()) {
+		SDL_Texture* out = preloaded->second;
+		this->preloadedTextures.erase(preloaded);
+		return out;
+	}
+
+	// Pixels in the asset pack are already decoded, upload them straight from the mapped file
+	const PackEntry* entry = this->pack.Find(path);
+	if(entry != NULL && entry->type == PACK_PIXELS) {
+		SDL_Texture* out = SDL_CreateTexture(this->r, entry->format, SDL_TEXTUREACCESS_STATIC, entry->width, entry->height);
+		if(out == NULL) return NULL;
+		if(SDL_UpdateTexture(out, NULL, this->pack.Data(entry), entry->pitch) < 0) {
+			SDL_DestroyTexture(out);
+			return NULL;
+		}
+		SDL_SetTextureBlendMode(out, SDL_BLENDMODE_BLEND);
+		registry.Add(out, RESOURCE_TEXTURE, (size_t)entry->pitch * entry->height, path);
+		return out;
+	} else if(entry != NULL) {
+		return this->LoadTexture(this->pack.Read(path), path);
+	}
+
 	SDL_Surface* surface = IMG_Load(path);
-	return (surface != NULL ? this->SurfaceToTexture(surface) : NULL);
+	return (surface != NULL ? this->SurfaceToTexture(surface, path) : NULL);
 }
 
-SDL_Texture* Engine::LoadTexture(SDL_RWops* data) {
+SDL_Texture* Engine::LoadTexture(SDL_RWops* data, const char* tag) {
+	PROFILE_SCOPE("LoadTexture");
 	SDL_Surface* surface = IMG_Load_RW(data, 1);
-	return (surface != NULL ? this->SurfaceToTexture(surface) : NULL);
+	return (surface != NULL ? this->SurfaceToTexture(surface, tag) : NULL);
 }
 
 #ifndef __EMSCRIPTEN__
 	Mix_Chunk* Engine::LoadSound(const char* path) {
-		return Mix_LoadWAV(path);
+		auto preloaded = this->preloadedSounds.find(path);
+		if(preloaded != this->preloadedSounds.end()) {
+			Mix_Chunk* out = preloaded->second;
+			this->preloadedSounds.erase(preloaded);
+			return out;
+		}
+
+		SDL_RWops* data = this->pack.Read(path);
+		if(data != NULL) return this->LoadSound(data, path);
+
+		PROFILE_SCOPE("LoadSound");
+		Mix_Chunk* out = Mix_LoadWAV(path);
+		if(out != NULL) registry.Add(out, RESOURCE_SOUND, out->alen, path);
+		return out;
+	}
+
+	Mix_Chunk* Engine::LoadSound(SDL_RWops* data, const char* tag) {
+		PROFILE_SCOPE("LoadSound");
+		Mix_Chunk* out = Mix_LoadWAV_RW(data, 1);
+		if(out != NULL) registry.Add(out, RESOURCE_SOUND, out->alen, tag);
+		return out;
+	}
+#endif
+
+#ifndef __EMSCRIPTEN__
+	Mix_Music* Engine::LoadMusic(const char* path) {
+		PROFILE_SCOPE("LoadMusic");
+		// Music is decoded while playing, no PCM is kept in memory
+		SDL_RWops* data = this->pack.Read(path);
+		Mix_Music* out = (data != NULL ? Mix_LoadMUS_RW(data, 1) : Mix_LoadMUS(path));
+		registry.Add(out, RESOURCE_MUSIC, 0, path);
+		return out;
 	}
 
-	Mix_Chunk* Engine::LoadSound(SDL_RWops* data) {
-		return Mix_LoadWAV_RW(data, 1);
+	void Engine::PostMix(void* data, Uint8* stream, int len) {
+		// Called by the audio thread after each mixed buffer
+		Engine* engine = (Engine*)data;
+		uint64_t now = ThreadCpuTime();
+		if(engine->audioLastCpu != 0) {
+			uint64_t cpu = now - engine->audioLastCpu;
+			engine->audioCpu += cpu;
+			if(cpu > engine->audioMaxCpu) engine->audioMaxCpu = cpu;
+		}
+		engine->audioLastCpu = now;
+		engine->audioFrames += len / engine->audioFrameSize;
+		engine->audioCallbacks++;
+
+		// Buffer arriving much later than its length means the device ran dry
+		uint64_t counter = SDL_GetPerformanceCounter();
+		if(engine->audioLastCounter != 0) {
+			double gap = (double)(counter - engine->audioLastCounter) / SDL_GetPerformanceFrequency();
+			if(gap > 1.5 * len / engine->audioFrameSize / engine->audioRate) {
+				engine->audioUnderruns++;
+			}
+		}
+		engine->audioLastCounter = counter;
+	}
+
+	std::string Engine::AudioReport() {
+		if(this->audioRate == 0) return "no audio device";
+		double seconds = (double)this->audioFrames / this->audioRate;
+		double cpu = this->audioCpu / 1000000.0;
+		uint64_t callbacks = this->audioCallbacks;
+		char out[256];
+		snprintf(out, sizeof(out), "%d Hz, %d samples (%.1lf ms), %d voices, %.2lf s mixed, audio thread used %.2lf ms CPU (%.2lf%%), "
+			"%.3lf ms per callback (max %.3lf ms), %llu underruns, %llu steals, %llu drops",
+			this->audioRate, this->audioSamples, this->audioSamples * 1000.0 / this->audioRate, (int)this->voicePriority.size(),
+			seconds, cpu, seconds > 0 ? cpu / 10 / seconds : 0, callbacks > 1 ? cpu / (callbacks - 1) : 0, this->audioMaxCpu / 1000000.0,
+			(unsigned long long)this->audioUnderruns, (unsigned long long)this->voiceSteals, (unsigned long long)this->voiceDrops);
+		return out;
 	}
 #endif
 
 TTF_Font* Engine::LoadFont(const char* path, int size) {
-	return TTF_OpenFont(path, size);
+	// Fonts preloaded or in the asset pack are opened from memory (shared by every size)
+	auto preloaded = this->preloadedFiles.find(path);
+	SDL_RWops* data = (preloaded != this->preloadedFiles.end() ?
+		SDL_RWFromConstMem(preloaded->second.data(), preloaded->second.size()) : this->pack.Read(path));
+	if(data != NULL) return this->LoadFont(data, size, path);
+
+	PROFILE_SCOPE("LoadFont");
+	TTF_Font* out = TTF_OpenFont(path, size);
+	registry.Add(out, RESOURCE_FONT, 0, path);
+	return out;
 }
 
-TTF_Font* Engine::LoadFont(SDL_RWops* data, int size) {
-	return TTF_OpenFontRW(data, 1, size);
+TTF_Font* Engine::LoadFont(SDL_RWops* data, int size, const char* tag) {
+	PROFILE_SCOPE("LoadFont");
+	TTF_Font* out = TTF_OpenFontRW(data, 1, size);
+	registry.Add(out, RESOURCE_FONT, 0, tag);
+	return out;
 }
 
 SDL_Texture* Engine::RenderText(TTF_Font* font, std::string text, SDL_Color color) {
+	PROFILE_SCOPE("RenderText");
 	SDL_Surface* surface = TTF_RenderUTF8_Blended(font, text.c_str(), color);
-	return (surface != NULL ? this->SurfaceToTexture(surface) : NULL);
+	return (surface != NULL ? this->SurfaceToTexture(surface, "RenderText") : NULL);
 }
 
 SDL_Texture* Engine::RenderSolidText(TTF_Font* font, std::string text, SDL_Color color) {
+	PROFILE_SCOPE("RenderSolidText");
 	SDL_Surface* surface = TTF_RenderUTF8_Solid(font, text.c_str(), color);
-	return (surface != NULL ? this->SurfaceToTexture(surface) : NULL);
+	return (surface != NULL ? this->SurfaceToTexture(surface, "RenderSolidText") : NULL);
+}
+
+bool TextKey::operator<(const TextKey &other) const {
+	if(this->font != other.font) return this->font < other.font;
+	if(this->color != other.color) return this->color < other.color;
+	if(this->mode != other.mode) return this->mode < other.mode;
+	return this->text < other.text;
+}
+
+SDL_Texture* Engine::GetText(TTF_Font* font, const std::string &text, SDL_Color color, int mode) {
+	if(font == NULL || text.empty()) return NULL;
+	TextKey key = { font, text, (uint32_t)color.r << 24 | (uint32_t)color.g << 16 | (uint32_t)color.b << 8 | (uint32_t)color.a, mode };
+
+	// Move cached text to the front of the LRU list
+	auto it = this->texts.find(key);
+	if(it != this->texts.end()) {
+		this->textHits++;
+		this->textOrder.splice(this->textOrder.begin(), this->textOrder, it->second.order);
+		return it->second.texture;
+	}
+
+	// Render new text
+	this->textMisses++;
+	SDL_Texture* texture = (mode == TEXT_SOLID ? this->RenderSolidText(font, text, color) : this->RenderText(font, text, color));
+	if(texture == NULL) return NULL;
+
+	int w, h;
+	if(SDL_QueryTexture(texture, NULL, NULL, &w, &h) < 0) {
+		DestroyResource(texture);
+		return NULL;
+	}
+
+	// Add text to the cache (texture is owned by the cache)
+	this->textOrder.push_front(key);
+	TextEntry entry = { texture, (size_t)w * h * 4, this->textOrder.begin() };
+	this->texts[key] = entry;
+	this->textCacheBytes += entry.bytes;
+	this->TrimTextCache();
+	return texture;
+}
+
+void Engine::TrimTextCache() {
+	// Evict least recently used texts (the newest one is always kept)
+	while(this->textCacheBytes > this->textCacheBudget && this->textOrder.size() > 1) {
+		auto it = this->texts.find(this->textOrder.back());
+		DestroyResource(it->second.texture);
+		this->textCacheBytes -= it->second.bytes;
+		this->texts.erase(it);
+		this->textOrder.pop_back();
+		this->textEvictions++;
+	}
+}
+
+void Engine::SetTextCacheBudget(size_t bytes) {
+	this->textCacheBudget = bytes;
+	this->TrimTextCache();
+}
+
+void Engine::ClearTextCache() {
+	for(auto &text: this->texts) {
+		DestroyResource(text.second.texture);
+	}
+	this->texts.clear();
+	this->textOrder.clear();
+	this->textCacheBytes = 0;
+}
+
+std::string Engine::TextCacheReport() {
+	uint64_t total = this->textHits + this->textMisses;
+	return std::to_string(this->texts.size()) + " texts, " + std::to_string(this->textCacheBytes / 1024) + "/" +
+		std::to_string(this->textCacheBudget / 1024) + " KB, " + std::to_string(this->textHits) + " hits, " +
+		std::to_string(this->textMisses) + " misses (" + std::to_string(total > 0 ? this->textHits * 100 / total : 0) + "% hit rate), " +
+		std::to_string(this->textEvictions) + " evictions";
+}
+
+GlyphAtlas* Engine::CreateGlyphAtlas(TTF_Font* font) {
+	PROFILE_SCOPE("CreateGlyphAtlas");
+	GlyphAtlas* atlas = new GlyphAtlas();
+	atlas->height = TTF_FontHeight(font);
+
+	// Render glyphs once (white, so color can be set when drawing)
+	SDL_Color white = { 255, 255, 255, 255 };
+	SDL_Surface* glyphs[GLYPH_LAST - GLYPH_FIRST + 1];
+	int x = 0, y = 0;
+	for(int i = 0; i <= GLYPH_LAST - GLYPH_FIRST; i++) {
+		int advance = 0;
+		TTF_GlyphMetrics(font, GLYPH_FIRST + i, NULL, NULL, NULL, NULL, &advance);
+		atlas->advances[i] = advance;
+		glyphs[i] = TTF_RenderGlyph_Solid(font, GLYPH_FIRST + i, white);
+
+		// Place glyphs in rows
+		int w = (glyphs[i] != NULL ? glyphs[i]->w : 0);
+		if(x + w > GLYPH_ATLAS_WIDTH) {
+			x = 0;
+			y += atlas->height;
+		}
+		atlas->glyphs[i] = { x, y, w, (glyphs[i] != NULL ? glyphs[i]->h : 0) };
+		x += w;
+	}
+
+	// Copy glyphs to one surface
+	SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, GLYPH_ATLAS_WIDTH, y + atlas->height, 32, SDL_PIXELFORMAT_RGBA8888);
+	for(int i = 0; i <= GLYPH_LAST - GLYPH_FIRST; i++) {
+		if(glyphs[i] != NULL) {
+			if(surface != NULL) {
+				SDL_BlitSurface(glyphs[i], NULL, surface, &atlas->glyphs[i]);
+			}
+			SDL_FreeSurface(glyphs[i]);
+		}
+	}
+
+	atlas->texture = (surface != NULL ? this->SurfaceToTexture(surface, "CreateGlyphAtlas") : NULL);
+	if(atlas->texture == NULL) {
+		if(surface != NULL) {
+			SDL_FreeSurface(surface);
+		}
+		delete atlas;
+		return NULL;
+	}
+	SDL_SetTextureBlendMode(atlas->texture, SDL_BLENDMODE_BLEND);
+	return atlas;
+}
+
+void Engine::DestroyGlyphAtlas(GlyphAtlas* atlas) {
+	if(atlas != NULL) {
+		DestroyResource(atlas->texture);
+		delete atlas;
+	}
+}
+
+int Engine::DrawGlyphs(GlyphAtlas* atlas, const char* text, int x, int y, SDL_Color color, int layer) {
+	if(atlas == NULL) return -1;
+
+	// Batch each character as a quad from the atlas (tinted by vertex color)
+	int start = x;
+	SDL_Rect dst;
+	for(const char* c = text; *c != '\0'; c++) {
+		if(*c < GLYPH_FIRST || *c > GLYPH_LAST) continue;
+		int i = *c - GLYPH_FIRST;
+		dst = { x, y, atlas->glyphs[i].w, atlas->glyphs[i].h };
+		if(dst.w > 0) {
+			this->batch.AddQuad(atlas->texture, &atlas->glyphs[i], &dst, color, SDL_FLIP_NONE, layer);
+		}
+		x += atlas->advances[i];
+	}
+	return x - start;
+}
+
+int Engine::AddSprite(const char* name, SDL_Texture* texture, SDL_Rect rect) {
+	int id = this->sprites.size();
+	this->sprites.push_back({ texture, rect });
+	this->spriteIds[name] = id;
+	return id;
+}
+
+int Engine::LoadAtlas(const char* path) {
+	PROFILE_SCOPE("LoadAtlas");
+	// Index lines are "page <file>" and "sprite <name> <page> <x> <y> <w> <h>"
+	std::istringstream index(this->ReadText(path));
+	if(index.str().empty()) return 0;
+
+	// Page files are relative to the index
+	std::string dir = path;
+	size_t slash = dir.find_last_of("/\\");
+	dir = (slash != std::string::npos ? dir.substr(0, slash + 1) : "");
+
+	std::vector<SDL_Texture*> pages;
+	std::vector<std::string> paths;
+	std::string line;
+	char name[128];
+	int page, x, y, w, h;
+	bool failed = false;
+	while(!failed && std::getline(index, line)) {
+		if(sscanf(line.c_str(), "page %127s", name) == 1) {
+			SDL_Texture* texture = this->LoadTexture((dir + name).c_str());
+			if(texture == NULL) {
+				failed = true;
+			} else {
+				pages.push_back(texture);
+				paths.push_back(dir + name);
+			}
+		} else if(sscanf(line.c_str(), "sprite %127s %d %d %d %d %d", name, &page, &x, &y, &w, &h) == 6) {
+			if(page < 0 || page >= (int)pages.size()) {
+				failed = true;
+			} else {
+				this->AddSprite(name, pages[page], { x, y, w, h });
+			}
+		}
+	}
+
+	// Loose images are used when the atlas is broken
+	if(failed) {
+		for(auto texture: pages) {
+			for(auto it = this->spriteIds.begin(); it != this->spriteIds.end();) {
+				if(this->sprites[it->second].texture == texture) {
+					this->sprites[it->second].texture = NULL;
+					it = this->spriteIds.erase(it);
+				} else {
+					it++;
+				}
+			}
+			DestroyResource(texture);
+		}
+		return 0;
+	}
+	this->spriteTextures.insert(this->spriteTextures.end(), pages.begin(), pages.end());
+	for(size_t i = 0; i < pages.size(); i++) {
+		this->spritePaths[paths[i]] = pages[i];
+	}
+	return pages.size();
+}
+
+std::vector<std::string> Engine::GetAtlasPages(const char* path) {
+	// Page paths from the atlas index (for loading them ahead of LoadAtlas)
+	std::istringstream index(this->ReadText(path));
+	std::string dir = path;
+	size_t slash = dir.find_last_of("/\\");
+	dir = (slash != std::string::npos ? dir.substr(0, slash + 1) : "");
+
+	std::vector<std::string> out;
+	std::string line;
+	char name[128];
+	while(std::getline(index, line)) {
+		if(sscanf(line.c_str(), "page %127s", name) == 1) {
+			out.push_back(dir + name);
+		}
+	}
+	return out;
+}
+
+int Engine::LoadSprite(const char* name, const char* path) {
+	// Sprites from the atlas are preferred over loose images
+	int id = this->GetSprite(name);
+	if(id >= 0) return id;
+
+	SDL_Texture* texture = this->LoadTexture(path);
+	if(texture == NULL) return -1;
+	SDL_Rect rect = { 0, 0, 0, 0 };
+	this->QueryTexture(texture, &rect);
+	this->spriteTextures.push_back(texture);
+	this->spritePaths[path] = texture;
+	return this->AddSprite(name, texture, rect);
+}
+
+int Engine::LoadSprite(const char* name, SDL_RWops* data, const char* tag) {
+	int id = this->GetSprite(name);
+	if(id >= 0) {
+		SDL_RWclose(data);
+		return id;
+	}
+
+	SDL_Texture* texture = this->LoadTexture(data, tag);
+	if(texture == NULL) return -1;
+	SDL_Rect rect = { 0, 0, 0, 0 };
+	this->QueryTexture(texture, &rect);
+	this->spriteTextures.push_back(texture);
+	return this->AddSprite(name, texture, rect);
+}
+
+int Engine::GetSprite(const char* name) {
+	auto it = this->spriteIds.find(name);
+	return (it != this->spriteIds.end() ? it->second : -1);
+}
+
+bool Engine::GetSpriteSize(int id, int* w, int* h) {
+	if(id < 0 || id >= (int)this->sprites.size() || this->sprites[id].texture == NULL) return false;
+	if(w != NULL) *w = this->sprites[id].rect.w;
+	if(h != NULL) *h = this->sprites[id].rect.h;
+	return true;
+}
+
+bool Engine::DrawSprite(int id, const SDL_Rect* dstrect, SDL_RendererFlip flip, SDL_Color color, int layer) {
+	if(id < 0 || id >= (int)this->sprites.size() || this->sprites[id].texture == NULL) return false;
+
+	// Consecutive sprites from one atlas page end up in one batch group
+	const Sprite &sprite = this->sprites[id];
+	this->batch.AddQuad(sprite.texture, &sprite.rect, dstrect, color, flip, layer);
+	return true;
+}
+
+void Engine::FreeSprites() {
+	for(auto texture: this->spriteTextures) {
+		DestroyResource(texture);
+	}
+	this->spriteTextures.clear();
+	this->spritePaths.clear();
+	this->sprites.clear();
+	this->spriteIds.clear();
+}
+
+bool Engine::ReloadTexture(LoadJob* job) {
+	PROFILE_SCOPE("ReloadTexture");
+	// Only images loaded as sprites (atlas pages and loose images) can be swapped
+	if(job == NULL || job->failed || job->type != LOAD_IMAGE) return false;
+	auto found = this->spritePaths.find(job->path);
+	if(found == this->spritePaths.end()) return false;
+	SDL_Texture* old = found->second;
+
+	// Same size image is uploaded into the existing texture
+	SDL_Rect rect = { 0, 0, 0, 0 };
+	uint32_t format = 0;
+	int access = 0;
+	this->QueryTexture(old, &rect, &format, &access);
+	if(rect.w == job->surface->w && rect.h == job->surface->h && access == SDL_TEXTUREACCESS_STATIC) {
+		SDL_Surface* converted = SDL_ConvertSurfaceFormat(job->surface, format, 0);
+		bool ok = (converted != NULL && SDL_UpdateTexture(old, NULL, converted->pixels, converted->pitch) == 0);
+		if(converted != NULL) SDL_FreeSurface(converted);
+		if(ok) return true;
+	}
+
+	// Otherwise new texture replaces the old one (whole image sprites follow the new size)
+	SDL_Texture* texture = this->SurfaceToTexture(job->surface, job->path.c_str());
+	if(texture == NULL) return false;
+	job->surface = NULL;
+	SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+	SDL_Rect size = { 0, 0, 0, 0 };
+	this->QueryTexture(texture, &size);
+	for(auto &sprite: this->sprites) {
+		if(sprite.texture != old) continue;
+		sprite.texture = texture;
+		if(sprite.rect.x == 0 && sprite.rect.y == 0 && sprite.rect.w == rect.w && sprite.rect.h == rect.h) {
+			sprite.rect = size;
+		}
+	}
+	for(auto &it: this->spriteTextures) {
+		if(it == old) it = texture;
+	}
+	found->second = texture;
+	this->batch.Forget(old);
+	DestroyResource(old);
+	return true;
 }
 
-SDL_Texture* Engine::CreateOverlay(int w, int h, SDL_Color color) {
+SDL_Texture* Engine::CreateOverlay(int w, int h, SDL_Color color, const char* tag) {
+	PROFILE_SCOPE("CreateOverlay");
 	// Create texture
-	SDL_Texture* overlay = this->CreateTexture(w, h, SDL_TEXTUREACCESS_TARGET);
+	SDL_Texture* overlay = this->CreateTexture(w, h, SDL_TEXTUREACCESS_TARGET, tag);
 	if(overlay != NULL) {
 		// Set texture transparency
 		SDL_SetTextureBlendMode(overlay, SDL_BLENDMODE_BLEND);
@@ -285,9 +1078,8 @@ SDL_Texture* Engine::CreateOverlay(int w, int h, SDL_Color color) {
 	return overlay;
 }
 
-bool Engine::DrawTriangle(int x, int y, SDL_Color color, int size, int direction) {
-	// Set dimensions
-	SDL_Point p[4];
+// Outline points of the triangle (last one closes it)
+static bool TrianglePoints(int x, int y, int size, int direction, SDL_Point* p) {
 	switch(direction) {
 		case TRIANGLE_UP:
 			p[0] = { x + size / 2, y };
@@ -316,6 +1108,17 @@ bool Engine::DrawTriangle(int x, int y, SDL_Color color, int size, int direction
 		default:
 			return false;
 	}
+	return true;
+}
+
+bool Engine::DrawTriangle(int x, int y, SDL_Color color, int size, int direction) {
+	PROFILE_SCOPE("DrawTriangle");
+	// Set dimensions
+	SDL_Point p[4];
+	if(!TrianglePoints(x, y, size, direction, p)) {
+		return false;
+	}
+	this->FlushBatch();
 
 	// Set triangle color
 	if(this->SetColor(color) < 0) {
@@ -323,6 +1126,8 @@ bool Engine::DrawTriangle(int x, int y, SDL_Color color, int size, int direction
 	}
 
 	// Create triangle
+	this->drawCalls++;
+	this->drawVertices += 4;
 	if(SDL_RenderDrawLines(this->r, p, 4) < 0) {
 		return false;
 	}
@@ -335,10 +1140,26 @@ bool Engine::DrawTriangle(int x, int y, SDL_Color color, int size, int direction
 	return true;
 }
 
+bool Engine::BatchTriangle(int x, int y, SDL_Color color, int size, int direction, int layer) {
+	SDL_Point p[4];
+	if(!TrianglePoints(x, y, size, direction, p)) {
+		return false;
+	}
+
+	// Batch triangle outline
+	for(int i = 0; i < 3; i++) {
+		this->batch.AddLine(p[i].x, p[i].y, p[i + 1].x, p[i + 1].y, color, layer);
+	}
+	return true;
+}
+
 bool Engine::DrawButton(TTF_Font* font, std::string text, SDL_Rect rect, SDL_Color font_color,
 			SDL_Color bg_color, SDL_Color border_color, int padding_x, int padding_y, int border_size) {
-	// Create button text
-	SDL_Texture* rendered_text = this->RenderText(font, text, font_color);
+	PROFILE_SCOPE("DrawButton");
+	this->FlushBatch();
+
+	// Get button text (cached)
+	SDL_Texture* rendered_text = this->GetText(font, text, font_color);
 	if(rendered_text == NULL) return false;
 
 	// Get button text size
@@ -357,7 +1178,7 @@ bool Engine::DrawButton(TTF_Font* font, std::string text, SDL_Rect rect, SDL_Col
 	}
 
 	// Render border
-	if(SDL_RenderFillRect(this->r, &rect) < 0) {
+	if(this->FillRect(&rect) < 0) {
 		return false;
 	}
 
@@ -373,7 +1194,7 @@ bool Engine::DrawButton(TTF_Font* font, std::string text, SDL_Rect rect, SDL_Col
 	rect.h = rect.h - border_size * 2;
 
 	// Render button background
-	if(SDL_RenderFillRect(this->r, &rect) < 0) {
+	if(this->FillRect(&rect) < 0) {
 		return false;
 	}
 
@@ -393,9 +1214,6 @@ bool Engine::DrawButton(TTF_Font* font, std::string text, SDL_Rect rect, SDL_Col
 		return false;
 	}
 
-	// Destroy button text
-	SDL_DestroyTexture(rendered_text);
-
 	return true;
 }
 
@@ -0,0 +1,297 @@
+#include <cstring>
+#include "../include/input.hpp"
+
+Input::Input() {
+	for(int i = 0; i < INPUT_ACTIONS; i++) {
+		this->Unbind(i);
+		this->pressTime[i] = 0;
+	}
+	memset(&this->state, 0, sizeof(this->state));
+	this->quit = false;
+	this->presses = 0;
+	this->latencySamples = 0;
+	this->latencyTotal = 0;
+	this->latencyMax = 0;
+	this->file = NULL;
+	this->recording = false;
+	this->replaying = false;
+	this->syncFrames = 0;
+}
+
+Input::~Input() {
+	this->Stop();
+}
+
+void Input::Bind(int action, SDL_Scancode key) {
+	if(action < 0 || action >= INPUT_ACTIONS) return;
+	for(int i = 0; i < INPUT_BINDS; i++) {
+		if(this->binds[action][i] == SDL_SCANCODE_UNKNOWN || this->binds[action][i] == key) {
+			this->binds[action][i] = key;
+			return;
+		}
+	}
+}
+
+bool Input::Bind(int action, std::string keys) {
+	// Keys are separated by commas and named like in SDL_GetScancodeName (e.g. "Up,W")
+	SDL_Scancode codes[INPUT_BINDS];
+	int count = 0;
+	size_t pos = 0;
+	while(pos <= keys.length() && count < INPUT_BINDS) {
+		size_t end = keys.find(',', pos);
+		if(end == std::string::npos) end = keys.length();
+		SDL_Scancode code = SDL_GetScancodeFromName(keys.substr(pos, end - pos).c_str());
+		if(code == SDL_SCANCODE_UNKNOWN) {
+			return false;
+		}
+		codes[count++] = code;
+		pos = end + 1;
+	}
+
+	this->Unbind(action);
+	for(int i = 0; i < count; i++) {
+		this->Bind(action, codes[i]);
+	}
+	return true;
+}
+
+void Input::Unbind(int action) {
+	if(action < 0 || action >= INPUT_ACTIONS) return;
+	for(int i = 0; i < INPUT_BINDS; i++) {
+		this->binds[action][i] = SDL_SCANCODE_UNKNOWN;
+	}
+}
+
+std::string Input::GetBinding(int action) {
+	std::string out = "";
+	if(action < 0 || action >= INPUT_ACTIONS) return out;
+	for(int i = 0; i < INPUT_BINDS && this->binds[action][i] != SDL_SCANCODE_UNKNOWN; i++) {
+		if(i > 0) out += ",";
+		out += SDL_GetScancodeName(this->binds[action][i]);
+	}
+	return out;
+}
+
+void Input::SetAction(int action, bool down, uint32_t timestamp) {
+	uint32_t bit = 1u << action;
+	if(down && !(this->state.down & bit)) {
+		this->state.down |= bit;
+		this->state.pressed |= bit;
+		this->pressTime[action] = timestamp;
+	} else if(!down && (this->state.down & bit)) {
+		this->state.down &= ~bit;
+		this->state.released |= bit;
+	}
+}
+
+void Input::Poll() {
+	// Handle all pending events, so none of them waits for the next frame
+	SDL_Event e;
+	while(SDL_PollEvent(&e)) {
+		switch(e.type) {
+			case SDL_QUIT:
+				this->quit = true;
+				break;
+			case SDL_KEYDOWN:
+			case SDL_KEYUP:
+				if(e.key.repeat || this->replaying) break;
+				for(int i = 0; i < INPUT_ACTIONS; i++) {
+					for(int j = 0; j < INPUT_BINDS && this->binds[i][j] != SDL_SCANCODE_UNKNOWN; j++) {
+						if(this->binds[i][j] == e.key.keysym.scancode) {
+							this->SetAction(i, e.type == SDL_KEYDOWN, e.key.timestamp);
+							break;
+						}
+					}
+				}
+				break;
+			case SDL_MOUSEMOTION:
+				if(this->replaying) break;
+				this->state.mouseX = e.motion.x;
+				this->state.mouseY = e.motion.y;
+				break;
+			case SDL_MOUSEBUTTONDOWN:
+				if(this->replaying) break;
+				this->state.mouseX = e.button.x;
+				this->state.mouseY = e.button.y;
+				this->state.buttons |= SDL_BUTTON(e.button.button);
+				this->state.clicked |= SDL_BUTTON(e.button.button);
+				break;
+			case SDL_MOUSEBUTTONUP:
+				if(this->replaying) break;
+				this->state.mouseX = e.button.x;
+				this->state.mouseY = e.button.y;
+				this->state.buttons &= ~SDL_BUTTON(e.button.button);
+				break;
+		}
+	}
+}
+
+void Input::Flush() {
+	this->state.pressed = 0;
+	this->state.released = 0;
+	this->state.clicked = 0;
+}
+
+bool Input::Down(int action) {
+	return (this->state.down >> action) & 1;
+}
+
+bool Input::Pressed(int action) {
+	uint32_t bit = 1u << action;
+	if(!(this->state.pressed & bit)) {
+		return false;
+	}
+	this->state.pressed &= ~bit;
+
+	this->presses++;
+
+	// Measure time from the key event to its handling (replayed presses have no event)
+	if(!this->replaying) {
+		uint32_t latency = SDL_GetTicks() - this->pressTime[action];
+		this->latencySamples++;
+		this->latencyTotal += latency;
+		if(latency > this->latencyMax) this->latencyMax = latency;
+	}
+	return true;
+}
+
+bool Input::Released(int action) {
+	uint32_t bit = 1u << action;
+	if(!(this->state.released & bit)) {
+		return false;
+	}
+	this->state.released &= ~bit;
+	return true;
+}
+
+bool Input::MouseDown(int button) {
+	return (this->state.buttons & SDL_BUTTON(button)) != 0;
+}
+
+bool Input::Clicked(int button) {
+	uint32_t mask = SDL_BUTTON(button);
+	if(!(this->state.clicked & mask)) {
+		return false;
+	}
+	this->state.clicked &= ~mask;
+	return true;
+}
+
+bool Input::StartRecording(const char* path, const void* header, uint32_t size) {
+	this->Stop();
+	this->file = fopen(path, "wb");
+	if(this->file == NULL) {
+		return false;
+	}
+
+	// Write signature, version and game header
+	uint8_t version = INPUT_REPLAY_VERSION;
+	if(fwrite(INPUT_REPLAY_MAGIC, 4, 1, this->file) != 1 || fwrite(&version, 1, 1, this->file) != 1 ||
+		fwrite(&size, 4, 1, this->file) != 1 || (size > 0 && fwrite(header, size, 1, this->file) != 1)) {
+		this->Stop();
+		return false;
+	}
+
+	memset(&this->last, 0, sizeof(this->last));
+	this->recording = true;
+	return true;
+}
+
+bool Input::StartReplay(const char* path, void* header, uint32_t size) {
+	this->Stop();
+	this->file = fopen(path, "rb");
+	if(this->file == NULL) {
+		return false;
+	}
+
+	// Check signature, version and game header size
+	char magic[4];
+	uint8_t version;
+	uint32_t headerSize;
+	if(fread(magic, 4, 1, this->file) != 1 || memcmp(magic, INPUT_REPLAY_MAGIC, 4) != 0 ||
+		fread(&version, 1, 1, this->file) != 1 || version != INPUT_REPLAY_VERSION ||
+		fread(&headerSize, 4, 1, this->file) != 1 || headerSize != size ||
+		(size > 0 && fread(header, size, 1, this->file) != 1)) {
+		this->Stop();
+		return false;
+	}
+
+	memset(&this->last, 0, sizeof(this->last));
+	memset(&this->state, 0, sizeof(this->state));
+	this->replaying = true;
+	return true;
+}
+
+void Input::Stop() {
+	if(this->file != NULL) {
+		fclose(this->file);
+		this->file = NULL;
+	}
+	this->recording = false;
+	this->replaying = false;
+}
+
+bool Input::Sync(double &time) {
+	// Frame record: changed fields mask, frame time and changed fields
+	enum {
+		SYNC_DOWN = 1, SYNC_PRESSED = 2, SYNC_RELEASED = 4,
+		SYNC_MOUSE = 8, SYNC_BUTTONS = 16, SYNC_CLICKED = 32
+	};
+	uint8_t changed = 0;
+
+	if(this->recording) {
+		if(this->state.down != this->last.down) changed |= SYNC_DOWN;
+		if(this->state.pressed != this->last.pressed) changed |= SYNC_PRESSED;
+		if(this->state.released != this->last.released) changed |= SYNC_RELEASED;
+		if(this->state.mouseX != this->last.mouseX || this->state.mouseY != this->last.mouseY) changed |= SYNC_MOUSE;
+		if(this->state.buttons != this->last.buttons) changed |= SYNC_BUTTONS;
+		if(this->state.clicked != this->last.clicked) changed |= SYNC_CLICKED;
+
+		bool ok = fwrite(&changed, 1, 1, this->file) == 1 && fwrite(&time, sizeof(time), 1, this->file) == 1;
+		if(ok && (changed & SYNC_DOWN)) ok = fwrite(&this->state.down, 4, 1, this->file) == 1;
+		if(ok && (changed & SYNC_PRESSED)) ok = fwrite(&this->state.pressed, 4, 1, this->file) == 1;
+		if(ok && (changed & SYNC_RELEASED)) ok = fwrite(&this->state.released, 4, 1, this->file) == 1;
+		if(ok && (changed & SYNC_MOUSE)) ok = fwrite(&this->state.mouseX, 4, 1, this->file) == 1 && fwrite(&this->state.mouseY, 4, 1, this->file) == 1;
+		if(ok && (changed & SYNC_BUTTONS)) ok = fwrite(&this->state.buttons, 4, 1, this->file) == 1;
+		if(ok && (changed & SYNC_CLICKED)) ok = fwrite(&this->state.clicked, 4, 1, this->file) == 1;
+		if(!ok) {
+			this->Stop();
+			return false;
+		}
+		this->last = this->state;
+		this->syncFrames++;
+	} else if(this->replaying) {
+		// Replay state starts from the previous frame (including edges not handled yet)
+		InputState next = this->last;
+		bool ok = fread(&changed, 1, 1, this->file) == 1 && fread(&time, sizeof(time), 1, this->file) == 1;
+		if(ok && (changed & SYNC_DOWN)) ok = fread(&next.down, 4, 1, this->file) == 1;
+		if(ok && (changed & SYNC_PRESSED)) ok = fread(&next.pressed, 4, 1, this->file) == 1;
+		if(ok && (changed & SYNC_RELEASED)) ok = fread(&next.released, 4, 1, this->file) == 1;
+		if(ok && (changed & SYNC_MOUSE)) ok = fread(&next.mouseX, 4, 1, this->file) == 1 && fread(&next.mouseY, 4, 1, this->file) == 1;
+		if(ok && (changed & SYNC_BUTTONS)) ok = fread(&next.buttons, 4, 1, this->file) == 1;
+		if(ok && (changed & SYNC_CLICKED)) ok = fread(&next.clicked, 4, 1, this->file) == 1;
+		if(!ok) {
+			// End of replay
+			this->Stop();
+			return false;
+		}
+		this->state = next;
+		this->last = next;
+		this->syncFrames++;
+	}
+	return true;
+}
+
+std::string Input::Report() {
+	if(this->presses == 0) {
+		return "No key presses handled";
+	}
+	char str[100];
+	if(this->latencySamples == 0) {
+		snprintf(str, 100, "Key presses handled: %llu (replayed, latency not measured)", (unsigned long long)this->presses);
+		return str;
+	}
+	snprintf(str, 100, "Key presses handled: %llu, latency: avg %.1fms, max %ums", (unsigned long long)this->presses,
+		(double)this->latencyTotal / this->latencySamples, this->latencyMax);
+	return str;
+}
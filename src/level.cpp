@@ -0,0 +1,164 @@
+#include <cstdio>
+#include <cstring>
+#include "../include/level.hpp"
+#include "../include/profiler.hpp"
+
+Level::Level() {
+	this->stages = NULL;
+	this->rects = NULL;
+	this->shapes = NULL;
+	this->count = 0;
+	this->size = 0;
+}
+
+bool Level::Open(const char* path) {
+	PROFILE_SCOPE("OpenLevel");
+	this->Close();
+	if(!this->file.Open(path)) return false;
+	return this->Attach(this->file.Data(), this->file.Size());
+}
+
+bool Level::Open(const void* data, size_t size) {
+	// Data is used in place (asset pack memory stays valid while it's open)
+	PROFILE_SCOPE("OpenLevel");
+	this->Close();
+	return this->Attach((const uint8_t*)data, size);
+}
+
+bool Level::Adopt(std::vector<uint8_t> &data) {
+	this->Close();
+	this->owned.swap(data);
+	return this->Attach(this->owned.data(), this->owned.size());
+}
+
+bool Level::Attach(const uint8_t* data, size_t size) {
+	// Check that the tables fit in the file and every stage points inside them
+	const LevelHeader* header = (const LevelHeader*)data;
+	if(data == NULL || size < sizeof(LevelHeader) || memcmp(header->magic, LEVEL_MAGIC, 4) != 0 || header->version != LEVEL_VERSION) {
+		this->Close();
+		return false;
+	}
+	uint64_t needed = sizeof(LevelHeader) + (uint64_t)header->stageCount * sizeof(LevelStage) +
+		(uint64_t)header->rectCount * sizeof(SDL_Rect) + (uint64_t)header->shapeCount * sizeof(LevelShape);
+	if(needed > size) {
+		this->Close();
+		return false;
+	}
+	const LevelStage* stages = (const LevelStage*)(data + sizeof(LevelHeader));
+	for(uint32_t i = 0; i < header->stageCount; i++) {
+		if(stages[i].firstRect > header->rectCount || stages[i].rectCount > header->rectCount - stages[i].firstRect ||
+			stages[i].firstShape > header->shapeCount || stages[i].shapeCount > header->shapeCount - stages[i].firstShape) {
+			this->Close();
+			return false;
+		}
+	}
+
+	this->stages = stages;
+	this->rects = (const SDL_Rect*)(stages + header->stageCount);
+	this->shapes = (const LevelShape*)(this->rects + header->rectCount);
+	this->count = header->stageCount;
+	this->size = size;
+	return true;
+}
+
+void Level::Close() {
+	this->file.Close();
+	this->owned.clear();
+	this->stages = NULL;
+	this->rects = NULL;
+	this->shapes = NULL;
+	this->count = 0;
+	this->size = 0;
+}
+
+uint32_t Level::Count() {
+	return this->count;
+}
+
+size_t Level::Size() {
+	return this->size;
+}
+
+const LevelStage* Level::Stage(uint32_t index) {
+	return (index < this->count ? &this->stages[index] : NULL);
+}
+
+const SDL_Rect* Level::Rects(const LevelStage* stage) {
+	return this->rects + stage->firstRect;
+}
+
+const LevelShape* Level::Shapes(const LevelStage* stage) {
+	return this->shapes + stage->firstShape;
+}
+
+void Level::Prefetch(const LevelStage* stage) {
+	// Platforms and shapes of the stage are read in before they are used
+	MappedFile::Prefetch(this->Rects(stage), stage->rectCount * sizeof(SDL_Rect));
+	MappedFile::Prefetch(this->Shapes(stage), stage->shapeCount * sizeof(LevelShape));
+}
+
+void LevelBuilder::AddStage(uint32_t flags) {
+	LevelStage stage;
+	memset(&stage, 0, sizeof(stage));
+	stage.flags = flags;
+	stage.firstRect = this->rects.size();
+	stage.firstShape = this->shapes.size();
+	this->stages.push_back(stage);
+}
+
+void LevelBuilder::AddRect(SDL_Rect rect) {
+	if(this->stages.empty()) this->AddStage();
+	this->rects.push_back(rect);
+	this->stages.back().rectCount++;
+}
+
+void LevelBuilder::AddTriangle(int x, int y, int size, int direction, SDL_Color color, int layer) {
+	if(this->stages.empty()) this->AddStage();
+	LevelShape shape;
+	memset(&shape, 0, sizeof(shape));
+	shape.type = SHAPE_TRIANGLE;
+	shape.direction = direction;
+	shape.layer = layer;
+	shape.x = x;
+	shape.y = y;
+	shape.size = size;
+	shape.color = color;
+	this->shapes.push_back(shape);
+	this->stages.back().shapeCount++;
+}
+
+uint32_t LevelBuilder::Count() {
+	return this->stages.size();
+}
+
+std::vector<uint8_t> LevelBuilder::Build() {
+	LevelHeader header;
+	memcpy(header.magic, LEVEL_MAGIC, 4);
+	header.version = LEVEL_VERSION;
+	header.stageCount = this->stages.size();
+	header.rectCount = this->rects.size();
+	header.shapeCount = this->shapes.size();
+	header.reserved = 0;
+
+	size_t stagesSize = this->stages.size() * sizeof(LevelStage);
+	size_t rectsSize = this->rects.size() * sizeof(SDL_Rect);
+	size_t shapesSize = this->shapes.size() * sizeof(LevelShape);
+	std::vector<uint8_t> out(sizeof(header) + stagesSize + rectsSize + shapesSize);
+	uint8_t* cursor = out.data();
+	memcpy(cursor, &header, sizeof(header));
+	cursor += sizeof(header);
+	if(stagesSize > 0) memcpy(cursor, this->stages.data(), stagesSize);
+	cursor += stagesSize;
+	if(rectsSize > 0) memcpy(cursor, this->rects.data(), rectsSize);
+	cursor += rectsSize;
+	if(shapesSize > 0) memcpy(cursor, this->shapes.data(), shapesSize);
+	return out;
+}
+
+bool LevelBuilder::Save(const char* path) {
+	std::vector<uint8_t> data = this->Build();
+	FILE* file = fopen(path, "wb");
+	if(file == NULL) return false;
+	bool ok = (fwrite(data.data(), 1, data.size(), file) == data.size());
+	return fclose(file) == 0 && ok;
+}
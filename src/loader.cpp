@@ -0,0 +1,165 @@
+#include <SDL2/SDL_image.h>
+#include "../include/loader.hpp"
+#include "../include/profiler.hpp"
+
+LoadJob::LoadJob(int type, const std::string &path) {
+	this->type = type;
+	this->path = path;
+	this->failed = false;
+	this->surface = NULL;
+	#ifndef __EMSCRIPTEN__
+		this->sound = NULL;
+	#endif
+}
+
+void LoadAsset(LoadJob &job, AssetPack* pack) {
+	PROFILE_SCOPE("LoadAsset");
+	const PackEntry* entry = (pack != NULL ? pack->Find(job.path) : NULL);
+	SDL_RWops* source = NULL;
+	if(entry != NULL) {
+		source = SDL_RWFromConstMem(pack->Data(entry), entry->size);
+	}
+
+	switch(job.type) {
+		case LOAD_IMAGE:
+			if(entry != NULL && entry->type == PACK_PIXELS) {
+				// Pixels in the pack are already decoded, the surface only points at them
+				job.surface = SDL_CreateRGBSurfaceWithFormatFrom((void*)pack->Data(entry), entry->width, entry->height,
+					32, entry->pitch, entry->format);
+				SDL_RWclose(source);
+			} else {
+				job.surface = (source != NULL ? IMG_Load_RW(source, 1) : IMG_Load(job.path.c_str()));
+			}
+			job.failed = (job.surface == NULL);
+			if(job.failed) job.error = IMG_GetError();
+			break;
+		case LOAD_FILE:
+			if(source == NULL) source = SDL_RWFromFile(job.path.c_str(), "rb");
+			if(source != NULL) {
+				Sint64 size = SDL_RWsize(source);
+				job.data.resize(size > 0 ? size : 0);
+				job.failed = (size <= 0 || SDL_RWread(source, job.data.data(), size, 1) != 1);
+				SDL_RWclose(source);
+			} else {
+				job.failed = true;
+			}
+			if(job.failed) job.error = SDL_GetError();
+			break;
+		#ifndef __EMSCRIPTEN__
+			case LOAD_SOUND:
+				job.sound = (source != NULL ? Mix_LoadWAV_RW(source, 1) : Mix_LoadWAV(job.path.c_str()));
+				job.failed = (job.sound == NULL);
+				if(job.failed) job.error = Mix_GetError();
+				break;
+		#endif
+		default:
+			if(source != NULL) SDL_RWclose(source);
+			job.failed = true;
+			job.error = "Unknown job type";
+	}
+}
+
+void FreeAsset(LoadJob &job) {
+	if(job.surface != NULL) SDL_FreeSurface(job.surface);
+	job.surface = NULL;
+	#ifndef __EMSCRIPTEN__
+		if(job.sound != NULL) Mix_FreeChunk(job.sound);
+		job.sound = NULL;
+	#endif
+}
+
+AssetLoader::AssetLoader(AssetPack* pack) {
+	this->pack = pack;
+	this->queued = 0;
+	this->taken = 0;
+	this->threads = 0;
+	this->startCounter = 0;
+	this->seconds = 0;
+}
+
+AssetLoader::~AssetLoader() {
+	this->Join();
+
+	// Free results that were never taken
+	for(auto &job: this->jobs) {
+		FreeAsset(job);
+	}
+}
+
+void AssetLoader::Add(int type, const char* path) {
+	this->jobs.push_back(LoadJob(type, path));
+}
+
+void AssetLoader::Start(uint32_t threads) {
+	this->startCounter = SDL_GetPerformanceCounter();
+	#ifndef __EMSCRIPTEN__
+		// One worker per core by default (never more than jobs)
+		if(threads == 0) threads = std::thread::hardware_concurrency();
+		if(threads == 0) threads = 2;
+		if(threads > this->jobs.size()) threads = this->jobs.size();
+		this->threads = threads;
+		for(uint32_t i = 0; i < threads; i++) {
+			this->workers.push_back(std::thread(&AssetLoader::Work, this));
+		}
+	#else
+		// Jobs run one by one from Next
+		this->threads = 0;
+	#endif
+}
+
+void AssetLoader::Run(size_t index) {
+	LoadAsset(this->jobs[index], this->pack);
+
+	std::lock_guard<std::mutex> guard(this->lock);
+	this->ready.push_back(index);
+}
+
+void AssetLoader::Work() {
+	while(true) {
+		size_t index;
+		{
+			std::lock_guard<std::mutex> guard(this->lock);
+			if(this->queued >= this->jobs.size()) return;
+			index = this->queued++;
+		}
+		this->Run(index);
+	}
+}
+
+LoadJob* AssetLoader::Next() {
+	if(this->workers.empty() && this->queued < this->jobs.size()) {
+		// Without workers the job runs here
+		this->Run(this->queued++);
+	}
+
+	std::lock_guard<std::mutex> guard(this->lock);
+	if(this->ready.empty()) return NULL;
+	size_t index = this->ready.front();
+	this->ready.pop_front();
+	this->taken++;
+	if(this->taken == this->jobs.size()) {
+		this->seconds = (double)(SDL_GetPerformanceCounter() - this->startCounter) / SDL_GetPerformanceFrequency();
+	}
+	return &this->jobs[index];
+}
+
+bool AssetLoader::Done() {
+	std::lock_guard<std::mutex> guard(this->lock);
+	return this->taken == this->jobs.size();
+}
+
+size_t AssetLoader::Total() {
+	return this->jobs.size();
+}
+
+size_t AssetLoader::Finished() {
+	std::lock_guard<std::mutex> guard(this->lock);
+	return this->taken;
+}
+
+void AssetLoader::Join() {
+	for(auto &worker: this->workers) {
+		worker.join();
+	}
+	this->workers.clear();
+}
@@ -1,8 +1,10 @@
 #define SDL_MAIN_HANDLED
 
 #include <ctime>
+#include <cmath>
 #include <cstdio>
 #include <iostream>
+#include <algorithm>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 #include <SDL2/SDL_image.h>
@@ -10,6 +12,7 @@
 	#include <SDL2/SDL_mixer.h>
 	#include "../include/easysock/tcp.hpp"
 	#include "../include/simpleini/SimpleIni.h"
+	#include "../include/pacer.hpp"
 	#ifndef NDISCORD
 		#include "../include/discord.hpp"
 	#endif
@@ -18,21 +21,49 @@
 	#include "../include/files.hpp"
 #endif
 #include "../include/game.hpp"
+#include "../include/input.hpp"
 #include "../include/engine.hpp"
+#include "../include/loader.hpp"
+#include "../include/profiler.hpp"
 
 // Game main functions
 void MainLoop();
 void FrameBegin();
 void FrameEnd();
 void Frame();
+void Update();
+int ResolveCollisions();
+void DrawStage(uint32_t stage);
+SDL_Texture* GetStageLayer(uint32_t stage);
+void CullStageLayers();
+void PrefetchStageLayer();
+void DrawPlayer(double x, double y);
+void CreateMenus();
+bool LoadLevel();
+void Shutdown();
+void BuildSyntheticLevel(LevelBuilder &builder, uint32_t stages, uint32_t platforms, uint32_t shapes);
+#ifndef __EMSCRIPTEN__
+	bool LoadAssets();
+	void DrawLoading(size_t done, size_t total);
+	void ApplyReloads();
+	bool ShowBenchmark();
+	bool BenchCollision();
+	bool BenchLevel();
+#endif
 
 // Create engine
 Engine engine(title, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, width, height);
 
+// Create input handler
+Input input;
+
 #ifndef __EMSCRIPTEN__
 	// Create INI parser
 	CSimpleIniA ini(true);
 
+	// Create frame pacer
+	Pacer pacer;
+
 	#ifndef NDISCORD
 		// Create Discord SDK
 		DiscordSDK discord(411983281886593024);
@@ -59,18 +90,39 @@ Engine engine(title, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, width, he
 #endif
 
 int main(int argc, char* argv[]) {
-	// Needed by rand() function
-	srand(time(0));
+	// Startup time is measured until the first frame
+	launchCounter = SDL_GetPerformanceCounter();
+
+	// Needed by rand() function (seed is saved in input recordings)
+	uint32_t seed = time(0);
+	srand(seed);
 
 	#ifndef __EMSCRIPTEN__
 		// Parse arguments
+		bool fpsSet = false;
 		for(int i = 1; i < argc; i++) {
 			std::string arg = argv[i];
 			if(arg == "--help" || arg == "-h") {
 				const char* msg = "  --help -h	Show this message\n"
 				                  "  --debug	Enable debugging\n"
 				                  "  --demo		Launch game presentation\n"
-				                  "  --skip-connect	Skip connecting to the server\n";
+				                  "  --skip-connect	Skip connecting to the server\n"
+				                  "  --fps=N	Limit frame rate to N (0 = uncapped)\n"
+				                  "  --vsync	Synchronize frame rate with the display\n"
+				                  "  --headless	Run without window, GPU and audio at full speed\n"
+				                  "  --no-render	Skip rendering (headless mode only)\n"
+				                  "  --trace=FILE	Write Chrome trace of frame phases to FILE\n"
+				                  "  --bench=N	Run demo for N frames and show frame time statistics\n"
+				                  "  --bench-out=FILE	Save benchmark results to FILE (JSON)\n"
+				                  "  --bench-collision	Measure collision queries against stage size and check for tunnelling\n"
+				                  "  --bench-level	Measure loading of a level with thousands of stages\n"
+				                  "  --bench-world=N	Play a generated level N stages wide (with --bench)\n"
+				                  "  --no-prefetch	Prepare stages only when they come into view\n"
+				                  "  --tick-rate=N	Run N simulation updates per second (default 50)\n"
+				                  "  --record=FILE	Record input to FILE (without server connection)\n"
+				                  "  --replay=FILE	Replay input recorded to FILE at full speed\n"
+				                  "  --load-threads=N	Decode assets on N threads (0 = one per core)\n"
+				                  "  --watch	Reload images and fonts when they change on disk\n";
 				DisplayInfo(title + std::string(" ") + version + std::string("\n") + msg);
 				return 0;
 			}
@@ -88,15 +140,131 @@ int main(int argc, char* argv[]) {
 				frame = 2;
 				skipconnect = true;
 			}
+			if(arg.compare(0, 6, "--fps=") == 0) {
+				fps = strtoul(arg.substr(6).c_str(), NULL, 10);
+				fpsSet = true;
+			}
+			if(arg == "--vsync" && !vsync) {
+				engine.vsync = true;
+				vsync = true;
+			}
+			if(arg == "--headless" && !headless) {
+				engine.headless = true;
+				headless = true;
+			}
+			if(arg == "--no-render" && !noRender) {
+				noRender = true;
+			}
+			if(arg.compare(0, 8, "--trace=") == 0) {
+				tracePath = arg.substr(8);
+				profiler.enabled = true;
+			}
+			if(arg.compare(0, 8, "--bench=") == 0) {
+				benchFrames = strtoul(arg.substr(8).c_str(), NULL, 10);
+			}
+			if(arg.compare(0, 12, "--bench-out=") == 0) {
+				benchPath = arg.substr(12);
+			}
+			if(arg == "--bench-collision") {
+				return BenchCollision() ? 0 : 1;
+			}
+			if(arg == "--bench-level") {
+				return BenchLevel() ? 0 : 1;
+			}
+			if(arg.compare(0, 14, "--bench-world=") == 0) {
+				worldStages = strtoul(arg.substr(14).c_str(), NULL, 10);
+			}
+			if(arg == "--no-prefetch") {
+				prefetch = false;
+			}
+			if(arg.compare(0, 12, "--tick-rate=") == 0) {
+				uint32_t rate = strtoul(arg.substr(12).c_str(), NULL, 10);
+				if(rate > 0) delta = 1.0 / rate;
+			}
+			if(arg.compare(0, 9, "--record=") == 0) {
+				recordPath = arg.substr(9);
+			}
+			if(arg.compare(0, 9, "--replay=") == 0) {
+				replayPath = arg.substr(9);
+			}
+			if(arg.compare(0, 15, "--load-threads=") == 0) {
+				loadThreads = strtoul(arg.substr(15).c_str(), NULL, 10);
+			}
+			if(arg == "--watch" && !watch) {
+				watch = true;
+			}
+		}
+
+		if(!recordPath.empty() || !replayPath.empty()) {
+			// Server connection can't be reproduced, so recordings are offline
+			if(!demo) frame = 2;
+			skipconnect = true;
+		}
+
+		ReplayHeader header;
+		if(!replayPath.empty()) {
+			// Restore starting state of recorded session
+			if(!input.StartReplay(replayPath.c_str(), &header, sizeof(header))) {
+				DisplayError("Can't read input recording from " + replayPath);
+				return 1;
+			}
+			seed = header.seed;
+			srand(seed);
+			frame = header.frame;
+			demo = header.demo;
+			isPlaying = header.isPlaying;
+			if(header.tickRate > 0) delta = 1.0 / header.tickRate;
+		} else if(!recordPath.empty()) {
+			// Save starting state of this session
+			memset(&header, 0, sizeof(header));
+			header.seed = seed;
+			header.frame = frame;
+			header.demo = demo;
+			header.isPlaying = isPlaying;
+			header.tickRate = (uint32_t)(1.0 / delta + 0.5);
+			if(!input.StartRecording(recordPath.c_str(), &header, sizeof(header))) {
+				DisplayError("Can't write input recording to " + recordPath);
+				return 1;
+			}
+		}
+
+		if(benchFrames > 0) {
+			// Run demo with fixed seed and one update per frame
+			srand(1);
+			isPlaying = true;
+			frame = 1;
+			demo = true;
+			profiler.enabled = true;
+			benchTimes.reserve(benchFrames);
+		}
+
+		if(headless || benchFrames > 0 || input.replaying) {
+			// Run at full speed unless frame rate is set
+			if(!fpsSet) fps = 0;
+			engine.vsync = false;
+			vsync = false;
+		}
+		if(!headless) {
+			// Rendering can be skipped only in headless mode
+			noRender = false;
 		}
+
+		// Set frame pacing mode
+		pacer.SetMode(vsync ? PACER_VSYNC : (fps > 0 ? PACER_CAPPED : PACER_UNCAPPED), fps);
 	#endif
 
 	// Init engine
 	if(!engine.Init()) {
 		DisplayError(engine.lastError);
+		Shutdown();
 		return 1;
 	}
 
+	// Set default controls
+	for(int i = 0; i < ACTIONS; i++) {
+		input.Bind(i, defaultKeys[i]);
+	}
+
 	#ifndef __EMSCRIPTEN__
 		if(!demo) {
 			// Load INI file
@@ -107,6 +275,22 @@ int main(int argc, char* argv[]) {
 			// Get volume
 			volume = strtoul(ini.GetValue("config", "volume", "100"), NULL, 10);
 			if(volume > 100) volume = 100;
+
+			// Get audio settings (buffer size in samples sets the latency)
+			audioRate = strtoul(ini.GetValue("audio", "rate", std::to_string(AUDIO_RATE).c_str()), NULL, 10);
+			audioSamples = strtoul(ini.GetValue("audio", "buffer", std::to_string(AUDIO_SAMPLES).c_str()), NULL, 10);
+			audioVoices = strtoul(ini.GetValue("audio", "voices", std::to_string(AUDIO_VOICES).c_str()), NULL, 10);
+
+			// Get text cache budget (in kilobytes)
+			engine.SetTextCacheBudget(strtoul(ini.GetValue("config", "text_cache", "4096"), NULL, 10) * 1024);
+
+			// Get controls (comma separated key names, e.g. "jump = Up,W")
+			for(int i = 0; i < ACTIONS; i++) {
+				const char* keys = ini.GetValue("controls", actionNames[i], NULL);
+				if(keys != NULL && !input.Bind(i, keys)) {
+					Log("Invalid controls for " + std::string(actionNames[i]) + " action (" + keys + ")");
+				}
+			}
 		}
 
 		// Set resource paths
@@ -136,55 +320,112 @@ int main(int argc, char* argv[]) {
 		SDL_RWops* counterFontData = SDL_RWFromConstMem(counter_font_raw, counter_font_raw_size);
 		if(bgData == NULL || menubgData == NULL || playerData == NULL || buttonFontData == NULL || optionFontData == NULL || counterFontData == NULL) {
 			DisplayError("Can't load required assets (" + std::string(SDL_GetError()) + ")");	
+			Shutdown();
 			return 1;
 		}
 	#endif
 
-	// Load textures
-	bg = engine.LoadTexture(bgData);
-	menubg = engine.LoadTexture(menubgData);
-	player = engine.LoadTexture(playerData);
-	if(bg == NULL || menubg == NULL || player == NULL) {
+	// Load sprites (from the atlas when it was built with "make atlas", otherwise from loose images)
+	#ifndef __EMSCRIPTEN__
+		// Assets are read from the pack when it was built with "make assets"
+		if(engine.OpenPack("assets.pack")) {
+			Log("Loaded asset pack (" + std::to_string(engine.pack.Count()) + " assets)");
+		}
+		Log("[Startup] Engine ready after " + NumToStr((double)(SDL_GetPerformanceCounter() - launchCounter) * 1000 / SDL_GetPerformanceFrequency()) + " ms");
+
+		// Decode assets on worker threads (loaders below take the results)
+		if(!LoadAssets()) {
+			Shutdown();
+			return 1;
+		}
+		if(engine.LoadAtlas("images/atlas.txt") > 0) {
+			Log("Loaded sprite atlas");
+		}
+		bgSprite = engine.LoadSprite("bg", bgData);
+		menubgSprite = engine.LoadSprite("menubg", menubgData);
+		playerSprite = engine.LoadSprite("player", playerData);
+	#else
+		bgSprite = engine.LoadSprite("bg", bgData, "bg_raw");
+		menubgSprite = engine.LoadSprite("menubg", menubgData, "menubg_raw");
+		playerSprite = engine.LoadSprite("player", playerData, "player_raw");
+	#endif
+	if(bgSprite < 0 || menubgSprite < 0 || playerSprite < 0) {
 		DisplayError("Can't load required assets (" + std::string(IMG_GetError()) + ")");
+		Shutdown();
 		return 1;
 	}
 
 	// Load fonts
-	buttonFont = engine.LoadFont(buttonFontData, 22);
-	optionFont = engine.LoadFont(optionFontData, 18);
-	counterFont = engine.LoadFont(counterFontData, 25);
+	#ifndef __EMSCRIPTEN__
+		buttonFont.Reset(engine.LoadFont(buttonFontData, 22));
+		optionFont.Reset(engine.LoadFont(optionFontData, 18));
+		counterFont.Reset(engine.LoadFont(counterFontData, 25));
+	#else
+		buttonFont.Reset(engine.LoadFont(buttonFontData, 22, "button_font_raw"));
+		optionFont.Reset(engine.LoadFont(optionFontData, 18, "button_font_raw"));
+		counterFont.Reset(engine.LoadFont(counterFontData, 25, "counter_font_raw"));
+	#endif
 	if(buttonFont == NULL || optionFont == NULL || counterFont == NULL) {
 		DisplayError("Can't load required assets (" + std::string(TTF_GetError()) + ")");
+		Shutdown();
+		return 1;
+	}
+
+	// Create counter glyph atlas
+	counterAtlas = engine.CreateGlyphAtlas(counterFont);
+	if(counterAtlas == NULL) {
+		DisplayError("Can't create glyph atlas (" + std::string(SDL_GetError()) + ")");
+		Shutdown();
 		return 1;
 	}
 
 	#ifndef __EMSCRIPTEN__
-		// Load sounds
-		bgsound = engine.LoadSound("sounds/bgsound.mp3");
-		if(bgsound == NULL) {
-			DisplayError("Can't load required assets (" + std::string(Mix_GetError()) + ")");
-			return 1;
-		}
+		// There is no audio device in headless mode
+		if(!headless) {
+			// Open audio device
+			if(!engine.InitAudio(audioRate, audioSamples, audioVoices)) {
+				DisplayError(engine.lastError);
+				Shutdown();
+				return 1;
+			}
 
-		// Setup sounds
-		// Channel 0 = background music
-		// Channel 1 = other
-		Mix_AllocateChannels(2);
-		Mix_Volume(0, volume / 100.0 * MIX_MAX_VOLUME);
+			// Load background music (streamed while playing)
+			bgmusic.Reset(engine.LoadMusic("sounds/bgsound.mp3"));
+			if(bgmusic == NULL) {
+				DisplayError("Can't load required assets (" + std::string(Mix_GetError()) + ")");
+				Shutdown();
+				return 1;
+			}
+
+			// Setup sounds (effects use the voice pool through engine.PlaySound)
+			Mix_VolumeMusic(volume / 100.0 * MIX_MAX_VOLUME);
+		}
 	#endif
 
 	// Create overlay
-	overlay = engine.CreateOverlay(width, height);
+	overlay.Reset(engine.CreateOverlay(width, height, { 0, 0, 0, 100 }, "overlay"));
 
-	// Create game frames cache
-	render1 = engine.CreateTexture(width, height, SDL_TEXTUREACCESS_TARGET);
-	render2 = engine.CreateTexture(width, height, SDL_TEXTUREACCESS_TARGET);
-
-	if(showCounter) {
-		// Create FPS counter
-		counter0 = engine.RenderSolidText(counterFont, "FPS: 0", frame == 1 ? black : dimwhite);
+	// Load stages
+	if(!LoadLevel()) {
+		DisplayError("Can't load level");
+		Shutdown();
+		return 1;
 	}
 
+	// Create menu widgets
+	CreateMenus();
+
+	#ifndef __EMSCRIPTEN__
+		// Watch asset directories (changes are applied at the start of the next frame)
+		if(watch) {
+			if(watcher.Start({ "images", "fonts" })) {
+				Log("[Watch] Watching images and fonts for changes");
+			} else {
+				Log("[Watch] Can't watch asset directories (only supported on Linux)");
+			}
+		}
+	#endif
+
 	#ifndef __EMSCRIPTEN__
 		// Init easysock (needed on Windows)
 		easysock::init();
@@ -292,22 +533,73 @@ int main(int argc, char* argv[]) {
 			}
 		#endif
 
+		uint64_t startCounter = SDL_GetPerformanceCounter();
 		while(true) {
-			if(fps > 0) {
-				// Get ticks at frame start
-				frameTicks = SDL_GetTicks();
-			}
-
 			// Run main loop
+			uint64_t frameCounter = SDL_GetPerformanceCounter();
+			uint32_t frameStage = gameFrame;
+			uint64_t frameViewChanges = viewChanges;
 			MainLoop();
 			if(quit) break;
 
-			if(fps > 0) {
-				// Wait remaining time
-				frameTicks = SDL_GetTicks() - frameTicks;
-				if(frameTicks < 1000 / fps) {
-					SDL_Delay(1000 / fps - frameTicks);
+			if(benchFrames > 0) {
+				// Save frame time and exit after the last benchmark frame
+				if(gameFrame != frameStage || viewChanges != frameViewChanges) {
+					benchTransitions.push_back(benchTimes.size());
 				}
+				benchTimes.push_back((double)(SDL_GetPerformanceCounter() - frameCounter) * 1000 / SDL_GetPerformanceFrequency());
+				if(benchTimes.size() >= benchFrames) {
+					frame = 0;
+				}
+			}
+
+			// Wait remaining time
+			PROFILE_SCOPE("Wait");
+			pacer.Wait();
+		}
+
+		// Show frame pacing and input accuracy
+		Log("[Pacer] " + pacer.Report());
+		Log("[Input] " + input.Report());
+		Log("[Text cache] " + engine.TextCacheReport());
+		Log("[Render state] " + engine.StateReport());
+		Log("[Audio] " + engine.AudioReport());
+		Log("[Resources] " + registry.Report());
+
+		// Report resources that were never destroyed
+		std::string leaks = registry.Leaks();
+		if(!leaks.empty()) {
+			std::cerr << "Leaked resources:" << std::endl << leaks;
+		}
+
+		if(!replayPath.empty()) {
+			// Show final state, so replays can be compared
+			std::cout << "Replayed " << input.syncFrames << " frames (" << updates << " updates), player at "
+			          << NumToStr(posX) << ", " << NumToStr(posY) << " in stage " << gameFrame << std::endl;
+		}
+		input.Stop();
+
+		// Save profiler trace
+		if(!tracePath.empty()) {
+			if(profiler.Export(tracePath.c_str())) {
+				Log("[Profiler] Trace saved to " + tracePath);
+			} else {
+				DisplayError("Can't save profiler trace to " + tracePath);
+			}
+		}
+
+		if(headless) {
+			// Show simulation throughput
+			double time = (double)(SDL_GetPerformanceCounter() - startCounter) / SDL_GetPerformanceFrequency();
+			std::cout << "Simulated " << pacer.frames << " frames (" << updates << " updates) in " << NumToStr(time) << " s, "
+			          << NumToStr(pacer.frames / time, 0) << " FPS, " << NumToStr(updates / time, 0) << " updates/s" << std::endl;
+		}
+
+		if(benchFrames > 0) {
+			// Show benchmark results
+			if(!ShowBenchmark()) {
+				DisplayError("Can't save benchmark results to " + benchPath);
+				return 1;
 			}
 		}
 	#else
@@ -319,6 +611,8 @@ int main(int argc, char* argv[]) {
 }
 
 void MainLoop() {
+	PROFILE_SCOPE("MainLoop");
+
 	// Exitting frame
 	if(frame == 0) {
 		#ifdef __EMSCRIPTEN__
@@ -333,23 +627,9 @@ void MainLoop() {
 		#endif
 
 		// Destroy resources
-		SDL_DestroyTexture(bg);
-		SDL_DestroyTexture(menubg);
-		SDL_DestroyTexture(player);
-		SDL_DestroyTexture(overlay);
-		SDL_DestroyTexture(render1);
-		SDL_DestroyTexture(render2);
-		SDL_DestroyTexture(counter0);
-
-		// Destroy fonts
-		TTF_CloseFont(buttonFont);
-		TTF_CloseFont(optionFont);
-		TTF_CloseFont(counterFont);
+		Shutdown();
 
 		#ifndef __EMSCRIPTEN__
-			// Destroy sounds
-			Mix_FreeChunk(bgsound);
-
 			// Quit easysock (needed on Windows)
 			easysock::exit();
 
@@ -367,6 +647,11 @@ void MainLoop() {
 		return;
 	}
 
+	#ifndef __EMSCRIPTEN__
+		// Swap in assets changed on disk
+		ApplyReloads();
+	#endif
+
 	// Load frame
 	if(lastFrame != frame) {
 		lastFrame = frame;
@@ -376,29 +661,6 @@ void MainLoop() {
 	// Run frame
 	Frame();
 
-	// Unload frame (frame end)
-	switch(lastFrame) {
-		case 1: // Game
-			// Destroy counter lines
-			SDL_DestroyTexture(counter1);
-			SDL_DestroyTexture(counter2);
-			SDL_DestroyTexture(counter3);
-			SDL_DestroyTexture(counter4);
-			SDL_DestroyTexture(counter5);
-			break;
-		case 2: // Main menu
-			//
-			break;
-		case 3: // Options
-			// Destroy volume label
-			SDL_DestroyTexture(volumeLabel);
-			break;
-		case 4: // Dialog box
-			// Destroy text
-			SDL_DestroyTexture(text);
-			break;
-	}
-
 	// Unload frame (frame change)
 	if(lastFrame != frame) {
 		FrameEnd();
@@ -406,9 +668,8 @@ void MainLoop() {
 }
 
 void FrameBegin() {
-	if(showCounter) {
-		counter0 = engine.RenderSolidText(counterFont, "FPS: " + NumToStr(fpsCount, 0), frame == 1 ? black : dimwhite);
-	}
+	// Forget keys pressed in the previous frame
+	input.Flush();
 
 	switch(frame) {
 		case 1: // Game
@@ -420,11 +681,13 @@ void FrameBegin() {
 					discord.UpdateRPC();
 				#endif
 
-				// Play background music
-				if(!Mix_Playing(0)) {
-					Mix_PlayChannel(0, bgsound, -1);
-				} else {
-					Mix_Resume(0);
+				// Play background music (not loaded in headless mode)
+				if(bgmusic != NULL) {
+					if(!Mix_PlayingMusic()) {
+						Mix_PlayMusic(bgmusic, -1);
+					} else {
+						Mix_ResumeMusic();
+					}
 				}
 			#else
 				// Play background music
@@ -453,18 +716,6 @@ void FrameBegin() {
 				#endif
 			#endif
 
-			// Create trackbar
-			trackbar = engine.CreateTexture(9, 25, SDL_TEXTUREACCESS_TARGET);
-			engine.SetTarget(trackbar);
-			engine.SetColor(white);
-			engine.Clear();
-			engine.SetColor(black);
-			engine.DrawLine(2, 8, 5, 1);
-			engine.DrawLine(2, 12, 5, 1);
-			engine.DrawLine(2, 16, 5, 1);
-			engine.SetColor(white);
-			engine.SetTarget(NULL);
-
 			// Reset mouse lock
 			mouseLock = false;
 			break;
@@ -486,7 +737,7 @@ void FrameEnd() {
 		case 1: // Game
 			// Pause background music
 			#ifndef __EMSCRIPTEN__
-				Mix_Pause(0);
+				Mix_PauseMusic();
 			#else
 				EM_ASM({
 					if(sdlgame_bgsound_play) sdlgame_bgsound_play(false);
@@ -497,9 +748,6 @@ void FrameEnd() {
 			//
 			break;
 		case 3: // Options
-			// Destroy trackbar
-			SDL_DestroyTexture(trackbar);
-
 			// Save config
 			#ifndef __EMSCRIPTEN__
 				ini.SetValue("config", "volume", NumToStr(volume, 0).c_str());
@@ -515,68 +763,83 @@ void FrameEnd() {
 }
 
 void Frame() {
+	PROFILE_SCOPE("Frame");
+
+	// Measure time elapsed since the last frame
+	uint64_t counter = SDL_GetPerformanceCounter();
+	frameTime = (lastCounter != 0 ? (double)(counter - lastCounter) / SDL_GetPerformanceFrequency() : 0);
+	lastCounter = counter;
+
+	#ifndef __EMSCRIPTEN__
+		// Benchmark runs exactly one update per frame, so it's deterministic
+		if(benchFrames > 0) {
+			frameTime = delta;
+		}
+	#endif
+
+	// Limit frame time to prevent spiral of death after long hitches
+	if(frameTime > maxFrameTime) {
+		frameTime = maxFrameTime;
+	}
+
 	if(showCounter) {
 		// FPS counting
 		fpsFrames++;
 		if(fpsFrameTicks + 1000 < SDL_GetTicks()) {
 			fpsCount = fpsFrames;
 			fpsFrames = 0;
-			counter0 = engine.RenderSolidText(counterFont, "FPS: " + NumToStr(fpsCount, 0), frame == 1 ? black : dimwhite);
 			fpsFrameTicks = SDL_GetTicks();
 		}
 	}
 
 	// Events
-	if(SDL_PollEvent(&e)) {
-		if(e.type == SDL_QUIT) {
+	{
+		PROFILE_SCOPE("Events");
+		input.Poll();
+		if(input.quit) {
 			frame = 0;
 			return;
 		}
+
+		#ifndef __EMSCRIPTEN__
+			// Save or load input state and frame time
+			bool replaying = input.replaying;
+			if(!input.Sync(frameTime)) {
+				if(!replaying) {
+					DisplayError("Can't write input recording to " + recordPath);
+				}
+				frame = 0;
+				return;
+			}
+		#endif
+
+		// Mouse handling
+		mouseX = input.state.mouseX;
+		mouseY = input.state.mouseY;
+
+		// Reset mouse lock
+		if(!input.MouseDown(SDL_BUTTON_LEFT) && mouseLock) {
+			mouseLock = false;
+		}
 	}
 
 	#ifndef __EMSCRIPTEN__
 		#ifndef NDISCORD
 			// Run Discord Presence tasks
-			discord.RunTasks();
+			{
+				PROFILE_SCOPE("Discord");
+				discord.RunTasks();
+			}
 		#endif
 	#endif
 
-	// Keyboard handling
-	key = SDL_GetKeyboardState(NULL);
-
-	// Mouse handling
-	mouse = SDL_GetMouseState(&mouseX, &mouseY);
-
-	// Reset key locks
-	if(!key[SDL_SCANCODE_ESCAPE] && escKey) {
-		escKey = false;
-	}
-	if(!key[SDL_SCANCODE_DOWN] && !key[SDL_SCANCODE_UP] && optKey) {
-		optKey = false;
-	}
-	if(!key[SDL_SCANCODE_RETURN] && enterKey) {
-		enterKey = false;
-	}
-	if(!key[SDL_SCANCODE_UP] && jumpKey) {
-		jumpKey = false;
-	}
-	if(!key[COUNTER_KEYCODE] && counterKey) {
-		counterKey = false;
-	}
-	if(!(mouse & SDL_BUTTON(SDL_BUTTON_LEFT)) && mouseLock) {
-		mouseLock = false;
-	}
-
 	// Show/hide counter
-	if(key[COUNTER_KEYCODE] && !counterKey) {
-		counterKey = true;
+	if(input.Pressed(ACTION_COUNTER)) {
 		showCounter = !showCounter;
-		counter0 = engine.RenderSolidText(counterFont, "FPS: " + NumToStr(fpsCount, 0), frame == 1 ? black : dimwhite);
 	}
 
 	// Show main menu, back to game or exit
-	if(key[SDL_SCANCODE_ESCAPE] && !escKey) {
-		escKey = true;
+	if(input.Pressed(ACTION_BACK)) {
 		if(frame != 4 || !dialogBox.buttonText.empty()) {
 			frame = (demo ? 0 : (frame != 2 ? 2 : (isPlaying ? 1 : 0)));
 		}
@@ -586,140 +849,19 @@ void Frame() {
 	switch(frame) {
 		case 1: // Game
 			if(!spectating) {
-				// If game frame is not changing
-				if(gameFrameChange == 0) {
-					// If not in demo mode
-					if(!demo) {
-						// Move right and left
-						if(key[SDL_SCANCODE_LEFT]) {
-							if(flip != SDL_FLIP_HORIZONTAL) flip = SDL_FLIP_HORIZONTAL;
-							posX -= speed * delta;
-						}
-						if(key[SDL_SCANCODE_RIGHT]) {
-							if(flip != SDL_FLIP_NONE) flip = SDL_FLIP_NONE;
-							posX += speed * delta;
-						}
-
-						// Jump
-						if(key[SDL_SCANCODE_UP] && !jumpKey && jumpState < 2) {
-							jumpKey = true;
-							jumpState++;
-							velocityY = -(jumpState == 2 ? jumpStrength * 2 : jumpStrength);
-						}
-						if(!key[SDL_SCANCODE_UP] && jumpKey) {
-							jumpKey = false;
-						}
-
-						// Must be used to prevent bugs, this will be shooting in the futsure
-						if((mouse & SDL_BUTTON(SDL_BUTTON_LEFT)) && !mouseLock) {
-							mouseLock = true;
-						}
-
-						// Gravity
-						posY += velocityY * delta;
-						if(posY < height - sizeY) {
-							if(jumpState != 3 && velocityY > 200) {
-								jumpState = 3;
-							}
-							velocityY += gravity * delta;
-						} else if(jumpState > 0) {
-							jumpState = 0;
-							velocityY = 0;
-						}
-					} else {
-						if(demoDirection) { // Left
-							if(flip != SDL_FLIP_HORIZONTAL) flip = SDL_FLIP_HORIZONTAL;
-							posX -= speed * delta;
-						} else { // Right
-							if(flip != SDL_FLIP_NONE) flip = SDL_FLIP_NONE;
-							posX += speed * delta;
-						}
-
-						// Gravity
-						posY += velocityY * delta;
-
-						// Jumping/Falling
-						if(posY < height - sizeY) {
-							if(jumpState == 1 && velocityY > 100) {
-								velocityY = -(jumpStrength * 2);
-								jumpState++;
-							}
-							if(jumpState != 3 && velocityY > 200) {
-								jumpState = 3;
-							}
-							velocityY += gravity * delta;
-						} else if(jumpState > 0) {
-							jumpState = 0;
-							velocityY = 0;
-						} else {
-							jumpState++;
-							velocityY = -jumpStrength;
-						}
-					}
-
-					// Go to next frame OR stop player on edge of window
-					if(gameFrame + 1 <= GAME_FRAMES) {
-						if(posX >= width - sizeX / 2) {
-							if(gameFrame == lastGameFrame) {
-								gameFrameChange = 1;
-							} else {
-								posX = width - sizeX / 2 - 1;
-							}
-						}
-					} else if(posX > width - sizeX) {
-						posX = width - sizeX;
-						if(demo) demoDirection = true;
-					}
-
-					// Go to previous frame OR stop player on edge of window
-					if(gameFrame - 1 > 0) {
-						if(posX <= sizeX / 2 - sizeX) {
-							if(gameFrame == lastGameFrame) {
-								gameFrameChange = -1;
-							} else {
-								posX = sizeX / 2 - sizeX + 1;
-							}
-						}
-					} else if(posX < 1) {
-						posX = 1;
-						if(demo) demoDirection = false;
-					}
-				}
-
-				// Move character if it's below bottom barrier of the window
-				if(posY > height - sizeY) {
-					posY = height - sizeY;
-				}
-
-				/* TODO: Make this working
-				if(CheckCollision()) {
-					if(posY + sizeY > rect.y && jumpState == 3) {
-						posY = rect.y - sizeY;
-					} else if(posY < rect.y + rect.h && (jumpState == 1 || jumpState == 2)) {
-						posY = rect.y + rect.h;
-					} else if(posX + sizeX > rect.x && key[SDL_SCANCODE_RIGHT]) {
-						posX = rect.x - sizeX;
-					} else if(posX < rect.x + rect.w && key[SDL_SCANCODE_LEFT]) {
-						posX = rect.x + rect.w;
-					}
+				// Run fixed timestep updates
+				accumulator += frameTime;
+				while(accumulator >= delta) {
+					Update();
+					accumulator -= delta;
 				}
-				*/
 
-				// On game frame change
-				if(gameFrameChange == 0 && gameFrame != lastGameFrame) {
-					lastGameFrame = gameFrame;
-
-					#ifndef __EMSCRIPTEN__
-						#ifndef NDISCORD
-							// Update Discord Presence
-							strcpy(discord.rpc.details, ("Stage " + NumToStr(gameFrame, 0)).c_str());
-							discord.UpdateRPC();
-						#endif
-					#endif
-				}
+				// Interpolation factor between the last two updates
+				alpha = accumulator / delta;
 
 				// Send player position to the server
 				if(!demo && connected && (posX != tmpX || posY != tmpY)) {
+					PROFILE_SCOPE("Network send");
 					tmpX = posX;
 					tmpY = posY;
 					#ifndef NDISCORD
@@ -734,6 +876,8 @@ void Frame() {
 					#endif
 				}
 			} else if(connected) {
+				PROFILE_SCOPE("Network receive");
+
 				// Get player position from the server
 				#ifndef NDISCORD
 					#ifndef __EMSCRIPTEN__
@@ -745,36 +889,26 @@ void Frame() {
 							return;
 						} else {
 							Unserialize(status, gameFrame, posX, posY);
+							prevX = posX;
+							prevY = posY;
 						}
 					#endif
 				#endif
 			}
-
-			// Reload counter
-			if(showCounter) {
-				counter1 = engine.RenderSolidText(counterFont, "X: " + NumToStr(posX), black);
-				counter2 = engine.RenderSolidText(counterFont, "Y: " + NumToStr(posY), black);
-				counter3 = engine.RenderSolidText(counterFont, "Frame: " + NumToStr(gameFrame, 0) + "/" + NumToStr(GAME_FRAMES, 0), black);
-				counter4 = engine.RenderSolidText(counterFont, "Jump state: " + NumToStr(jumpState, 0), black);
-				counter5 = engine.RenderSolidText(counterFont, "Velocity: " + NumToStr(velocityY), black);
-			}
 			break;
 		case 2: // Main menu
 			// Change option
-			if(key[SDL_SCANCODE_UP] && !optKey) {
-				optKey = true;
+			if(input.Pressed(ACTION_UP)) {
 				option--;
 				if(option < 1) option = 3;
 			}
-			if(key[SDL_SCANCODE_DOWN] && !optKey) {
-				optKey = true;
+			if(input.Pressed(ACTION_DOWN)) {
 				option++;
 				if(option > 3) option = 1;
 			}
 
 			// Accept
-			if(key[SDL_SCANCODE_RETURN] && !enterKey) {
-				enterKey = true;
+			if(input.Pressed(ACTION_ACCEPT)) {
 				if(option == 1) { // Play / Back to game
 					if(!isPlaying) isPlaying = true;
 					frame = 1;
@@ -788,60 +922,56 @@ void Frame() {
 				}
 			}
 
-			// Hover
-			if(mouseX > 300 && mouseX <= 500 && mouseY > 200 && mouseY <= 248 && (mouseX != lastX || mouseY != lastY)) { // Play / Back to game
-				option = 1;
-				lastX = mouseX;
-				lastY = mouseY;
-			}
-			if(mouseX > 300 && mouseX <= 500 && mouseY > 260 && mouseY <= 308 && (mouseX != lastX || mouseY != lastY)) { // Options
-				option = 2;
-				lastX = mouseX;
-				lastY = mouseY;
-			}
-			if(mouseX > 300 && mouseX <= 500 && mouseY > 320 && mouseY <= 368 && (mouseX != lastX || mouseY != lastY)) { // Exit
-				option = 3;
-				lastX = mouseX;
-				lastY = mouseY;
-			}
+			{
+				// Hover
+				Widget* hover = mainMenu.HitTest(mouseX, mouseY);
+				for(int i = 0; i < 3; i++) {
+					if(hover == menuButtons[i] && (mouseX != lastX || mouseY != lastY)) {
+						option = i + 1;
+						lastX = mouseX;
+						lastY = mouseY;
+					}
+				}
 
-			// Click
-			if((mouse & SDL_BUTTON(SDL_BUTTON_LEFT)) && !mouseLock) {
-				mouseLock = true;
-				if(mouseX > 300 && mouseX <= 500 && mouseY > 200 && mouseY <= 248) { // Back to game
-					if(!isPlaying) isPlaying = true;
-					frame = 1;
-					return;
-				} else if(mouseX > 300 && mouseX <= 500 && mouseY > 260 && mouseY <= 308) { // Options
-					frame = 3;
-					return;
-				} else if(mouseX > 300 && mouseX <= 500 && mouseY > 320 && mouseY <= 368) { // Exit
-					frame = 0;
-					return;
+				// Click
+				if(input.Clicked(SDL_BUTTON_LEFT)) {
+					if(hover == menuButtons[0]) { // Play / Back to game
+						if(!isPlaying) isPlaying = true;
+						frame = 1;
+						return;
+					} else if(hover == menuButtons[1]) { // Options
+						frame = 3;
+						return;
+					} else if(hover == menuButtons[2]) { // Exit
+						frame = 0;
+						return;
+					}
 				}
 			}
+
+			// Update buttons (redrawn only when changed)
+			menuButtons[0]->SetText(isPlaying ? "Back to game" : "Play");
+			for(int i = 0; i < 3; i++) {
+				menuButtons[i]->SetFocus(option == i + 1);
+			}
 			break;
 		case 3: // Options
 			// Dragging trackbar
-			if(mouse & SDL_BUTTON(SDL_BUTTON_LEFT)) {
+			if(input.MouseDown(SDL_BUTTON_LEFT)) {
 				if(mouseX != lastX || mouseY != lastY) {
 					if(!mouseLock) {
-						if(mouseX >= 126 + volume && mouseX <= 135 + volume && mouseY >= 30 && mouseY <= 55) {
-							mouseLock = true;
-						} else if(mouseX >= 130 && mouseX <= 230 && mouseY >= 40 && mouseY <= 45) {
-							volume = mouseX - 130;
+						if(optionsMenu.HitTest(mouseX, mouseY) == volumeBar) {
+							if(volumeBar->OnThumb(mouseX)) {
+								mouseLock = true;
+							} else {
+								volume = volumeBar->ValueAt(mouseX);
+							}
 						}
 					} else {
-						if(mouseX < 130) {
-							volume = 0;
-						} else if(mouseX > 230) {
-							volume = 100;
-						} else {
-							volume = mouseX - 130;
-						}
+						volume = volumeBar->ValueAt(mouseX);
 					}
 					#ifndef __EMSCRIPTEN__
-						Mix_Volume(0, volume / 100.0 * MIX_MAX_VOLUME);
+						Mix_VolumeMusic(volume / 100.0 * MIX_MAX_VOLUME);
 					#else
 						EM_ASM({
 							if(sdlgame_volume_change) sdlgame_volume_change($0);
@@ -852,246 +982,841 @@ void Frame() {
 				}
 			}
 
-			// Update volume label
-			volumeLabel = engine.RenderText(optionFont, "Volume (" + NumToStr(volume, 0) + ")", white);
+			// Update volume widgets (redrawn only when changed)
+			volumeBar->SetValue(volume);
+			volumeLabel->SetText("Volume (" + NumToStr(volume, 0) + ")");
 			break;
 		case 4: // Dialog box
 			// If dialog box buttons is shown
 			if(!dialogBox.buttonText.empty()) {
 				// Accept
-				if(key[SDL_SCANCODE_RETURN] && !enterKey) {
-					enterKey = true;
+				if(input.Pressed(ACTION_ACCEPT)) {
 					frame = 2;
 					break;
 				}
 
 				// Hide dialog box
-				if(key[SDL_SCANCODE_ESCAPE] && !escKey) {
-					escKey = true;
+				if(input.Pressed(ACTION_BACK)) {
 					frame = 2;
 					break;
 				}
 
 				// Click
-				if((mouse & SDL_BUTTON(SDL_BUTTON_LEFT)) && !mouseLock) {
-					mouseLock = true;
-					if(mouseX > 300 && mouseX <= 500 && mouseY > 300 && mouseY <= 348) {
+				if(input.Clicked(SDL_BUTTON_LEFT)) {
+					if(dialogMenu.HitTest(mouseX, mouseY) == dialogButton) {
 						frame = 2;
 						break;
 					}
 				}
 			}
 
-			// Render text
-			text = engine.RenderText(buttonFont, dialogBox.text, white);
+			// Update dialog widgets (redrawn only when changed)
+			dialogText->SetText(dialogBox.text);
+			dialogButton->SetText(dialogBox.buttonText);
+			dialogButton->SetVisible(!dialogBox.buttonText.empty());
 			break;
 	}
 
 	//////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+	// Skip rendering (headless mode)
+	if(noRender) {
+		return;
+	}
+
+	PROFILE_SCOPE("Draw");
+
 	// Clear renderer
 	engine.Clear();
 
 	switch(frame) {
 		case 1: // Game
-			if(gameFrame == lastGameFrame) {
-				// Executed when current game frame is about to render
-				if(gameFrameChange != 0) {
-					// Render current game frame to the cache
-					engine.SetTarget(render1);
-					engine.Clear();
-				}
-
-				do {
-					// Render background (flip horizontally if gameFrame is even)
-					engine.Draw(bg, NULL, NULL, 0, NULL, gameFrame % 2 ? SDL_FLIP_NONE : SDL_FLIP_HORIZONTAL);
-
-					// Render game frames
-					switch(gameFrame) {
-						case 1:
-							// Render triangles
-							engine.DrawTriangle(width - 110, height / 2 - 100, black, 100, TRIANGLE_RIGHT);
-							engine.DrawTriangle(width - 350, height / 2 - 100, black, 100, TRIANGLE_UP);
-							engine.DrawTriangle(250, height / 2 - 100, black, 100, TRIANGLE_DOWN);
-							engine.DrawTriangle(10, height / 2 - 100, black, 100, TRIANGLE_LEFT);
-							break;
-						case 2:
-							// Render left and right triangle
-							engine.DrawTriangle(10, height / 2 - 100, black, 100, TRIANGLE_LEFT);
-							engine.DrawTriangle(width - 110, height / 2 - 100, black, 100, TRIANGLE_RIGHT);
-							break;
-						case 3:
-							// Render left triangle
-							engine.DrawTriangle(10, height / 2 - 100, black, 100, TRIANGLE_LEFT);
-							break;
+			{
+				// Camera follows the player (interpolated between the last two updates, in world coordinates)
+				double playerX = (double)(gameFrame - 1) * width + prevX + (posX - prevX) * alpha;
+				camera.Follow(playerX + sizeX / 2.0);
+				int64_t cameraX = (int64_t)std::floor(camera.x);
+
+				// Render chunks in the viewport only (cost doesn't grow with the level)
+				static uint32_t viewFirst, viewLast;
+				uint64_t rendered = stageLayersRendered;
+				uint32_t first, last;
+				if(camera.Visible(first, last)) {
+					for(uint32_t i = first; i <= last; i++) {
+						SDL_Texture* layer = GetStageLayer(i + 1);
+						rect = { (int)((int64_t)i * width - cameraX), 0, width, height };
+						engine.Draw(layer, NULL, &rect);
 					}
-
-					for(uint8_t i = 0; i < collisionCounts[gameFrame - 1]; i++) {
-						SDL_RenderFillRect(engine.r, &collisions[gameFrame - 1][i]);
-					}
-
-					// Set player size and position
-					rect.x = posX;
-					rect.y = posY;
-					rect.w = sizeX;
-					rect.h = sizeY;
-
-					// Render player
-					engine.Draw(player, NULL, &rect, 0, NULL, flip);
-
-					// Executed when new game frame is about to render
-					if(gameFrameChange != 0 && gameFrame == lastGameFrame) {
-						// Render new game frame to the cache
-						gameFrame += gameFrameChange;
-						posX += (gameFrameChange < 0 ? width : -width);
-						engine.SetTarget(render2);
-						engine.Clear();
-					} else {
-						break;
+					chunksDrawn += last - first + 1;
+					if(first != viewFirst || last != viewLast) {
+						viewFirst = first;
+						viewLast = last;
+						viewChanges++;
 					}
-				} while(1);
-
-				// Executed when game frames has been rendered
-				if(gameFrameChange != 0) {
-					engine.SetTarget(NULL);
-					renderPos = 0;
 				}
-			}
-			if(gameFrameChange != 0) {
-				// Animate game frame change
-				rect.x = renderPos;
-				rect.y = 0;
-				rect.w = width;
-				rect.h = height;
-				engine.Draw(render1, NULL, &rect);
-
-				rect.x = renderPos + (gameFrameChange < 0 ? -width : width);
-				rect.y = 0;
-				rect.w = width;
-				rect.h = height;
-				engine.Draw(render2, NULL, &rect);
-
-				renderPos -= gameFrameChange * (width / 20);
-				if(renderPos <= -width || renderPos >= width) {
-					gameFrameChange = 0;
+				CullStageLayers();
+
+				// Render one layer coming into view if this frame didn't render any
+				if(prefetch && stageLayersRendered == rendered) {
+					PrefetchStageLayer();
 				}
+				DrawPlayer(playerX - cameraX, prevY + (posY - prevY) * alpha);
 			}
 
 			if(showCounter) {
 				// Loop through counter lines
-				for(int i = 1; i <= 5; i++) {
-					// Get counter line by index
-					SDL_Texture* counter = (i == 1 ? counter1 : i == 2 ? counter2 : i == 3 ? counter3 : i == 4 ? counter4 : i == 5 ? counter5 : NULL);
+				char line[64];
+				for(int i = 1; i <= COUNTER_LINES; i++) {
+					// Format counter line by index
+					switch(i) {
+						case 1: snprintf(line, sizeof(line), "X: %.2lf", posX); break;
+						case 2: snprintf(line, sizeof(line), "Y: %.2lf", posY); break;
+						case 3: snprintf(line, sizeof(line), "Frame: %u/%u", gameFrame, level.Count()); break;
+						case 4: snprintf(line, sizeof(line), "Jump state: %u", jumpState); break;
+						case 5: snprintf(line, sizeof(line), "Velocity: %.2lf", velocityY); break;
+						case 6: snprintf(line, sizeof(line), "VRAM: %u KB (peak %u KB)", (uint32_t)(registry.bytes[RESOURCE_TEXTURE] / 1024), (uint32_t)(registry.peak[RESOURCE_TEXTURE] / 1024)); break;
+						case 7: snprintf(line, sizeof(line), "Draw calls: %u (%u vertices)", engine.frameDrawCalls, engine.frameDrawVertices); break;
+						case 8: snprintf(line, sizeof(line), "State calls: %u (%u skipped)", engine.frameStateCalls, engine.frameStateSkips); break;
+						#ifndef __EMSCRIPTEN__
+							case 9: snprintf(line, sizeof(line), "Audio: %.3lf ms max mix, %u underruns", engine.audioMaxCpu / 1000000.0, (uint32_t)engine.audioUnderruns); break;
+						#endif
+					}
 
 					// Display counter line
-					engine.QueryTexture(counter, &rect);
-					rect.x = 10;
-					rect.y = 4 + (18 * i);
-					engine.Draw(counter, NULL, &rect);
+					engine.DrawGlyphs(counterAtlas, line, 10, 4 + (18 * i), black, LAYER_HUD);
 				}
 			}
 			break;
 		case 2: // Main menu
-			// Render background
-			engine.Draw(menubg);
-
-			// Render background overlay
-			engine.Draw(overlay);
-
-			// Set button size and position
-			rect.x = 300;
-			rect.y = 200;
-			rect.w = 200;
-			rect.h = 50;
-
-			// Render button
-			engine.DrawButton(buttonFont, isPlaying ? "Back to game" : "Play", rect, white, green, option == 1 ? red : green);
-
-			// Set button size and position
-			rect.x = 300;
-			rect.y = 260;
-			rect.w = 200;
-			rect.h = 50;
-
-			// Render button
-			engine.DrawButton(buttonFont, "Options", rect, white, green, option == 2 ? red : green);
-
-			// Set button size and position
-			rect.x = 300;
-			rect.y = 320;
-			rect.w = 200;
-			rect.h = 50;
-
-			// Render button
-			engine.DrawButton(buttonFont, "Exit", rect, white, green, option == 3 ? red : green);
+			// Render menu (one blit unless some widget changed)
+			mainMenu.Draw(&engine);
 			break;
 		case 3: // Options
-			// Render background
-			engine.Draw(menubg);
-
-			// Render background overlay
-			engine.Draw(overlay);
-
-			// Display volume label
-			engine.QueryTexture(volumeLabel, &rect);
-			rect.x = 10;
-			rect.y = 30;
-			engine.Draw(volumeLabel, NULL, &rect);
-
-			// Display volume trackbar
-			rect.x = 130;
-			rect.y = 40;
-			rect.w = 100;
-			rect.h = 5;
-			engine.SetColor(dimwhite);
-			SDL_RenderFillRect(engine.r, &rect);
-			engine.SetColor(white);
-
-			rect.x = 126 + volume;
-			rect.y = 30;
-			rect.w = 9;
-			rect.h = 25;
-			engine.Draw(trackbar, NULL, &rect);
+			// Render options
+			optionsMenu.Draw(&engine);
 			break;
 		case 4: // Dialog box
-			// Render background
-			engine.Draw(menubg);
-
-			// Render background overlay
-			engine.Draw(overlay);
-
-			// Display text
-			engine.QueryTexture(text, &rect);
-			rect.x = width / 2 - rect.w / 2;
-			rect.y = 260;
-			engine.Draw(text, NULL, &rect);
-
-			// Set button size and position
-			rect.x = 300;
-			rect.y = 300;
-			rect.w = 200;
-			rect.h = 50;
-
-			// If dialog box buttons is shown
-			if(!dialogBox.buttonText.empty()) {
-				// Render button
-				engine.DrawButton(buttonFont, dialogBox.buttonText, rect, white, green, red);
-			}
+			// Render dialog box
+			dialogMenu.Draw(&engine);
 			break;
 	}
 
 	if(showCounter) {
 		// Display FPS counter
-		engine.QueryTexture(counter0, &rect);
-		rect.x = 10;
-		rect.y = 4;
-		engine.Draw(counter0, NULL, &rect);
+		char line[32];
+		snprintf(line, sizeof(line), "FPS: %u", fpsCount);
+		engine.DrawGlyphs(counterAtlas, line, 10, 4, frame == 1 ? black : dimwhite, LAYER_HUD);
 	}
 
 	// Show render
 	engine.Present();
+
+	if(launchCounter != 0) {
+		Log("[Startup] First frame after " + NumToStr((double)(SDL_GetPerformanceCounter() - launchCounter) * 1000 / SDL_GetPerformanceFrequency()) + " ms");
+		launchCounter = 0;
+	}
+}
+
+void Update() {
+	PROFILE_SCOPE("Update");
+	updates++;
+
+	// Save previous state for interpolation
+	prevX = posX;
+	prevY = posY;
+
+	// If not in demo mode
+	if(!demo) {
+		// Move right and left
+		if(input.Down(ACTION_LEFT)) {
+			if(flip != SDL_FLIP_HORIZONTAL) flip = SDL_FLIP_HORIZONTAL;
+			posX -= speed * delta;
+		}
+		if(input.Down(ACTION_RIGHT)) {
+			if(flip != SDL_FLIP_NONE) flip = SDL_FLIP_NONE;
+			posX += speed * delta;
+		}
+
+		// Jump
+		if(input.Pressed(ACTION_JUMP) && jumpState < 2) {
+			jumpState++;
+			velocityY = -(jumpState == 2 ? jumpStrength * 2 : jumpStrength);
+		}
+
+		// Gravity
+		posY += velocityY * delta;
+		int contacts = ResolveCollisions();
+		if(posY < height - sizeY && !(contacts & CONTACT_GROUND)) {
+			if(jumpState != 3 && velocityY > 200) {
+				jumpState = 3;
+			}
+			velocityY += gravity * delta;
+		} else if(jumpState > 0) {
+			jumpState = 0;
+			velocityY = 0;
+		}
+	} else {
+		if(demoDirection) { // Left
+			if(flip != SDL_FLIP_HORIZONTAL) flip = SDL_FLIP_HORIZONTAL;
+			posX -= speed * delta;
+		} else { // Right
+			if(flip != SDL_FLIP_NONE) flip = SDL_FLIP_NONE;
+			posX += speed * delta;
+		}
+
+		// Gravity
+		posY += velocityY * delta;
+		int contacts = ResolveCollisions();
+
+		// Jumping/Falling
+		if(posY < height - sizeY && !(contacts & CONTACT_GROUND)) {
+			if(jumpState == 1 && velocityY > 100) {
+				velocityY = -(jumpStrength * 2);
+				jumpState++;
+			}
+			if(jumpState != 3 && velocityY > 200) {
+				jumpState = 3;
+			}
+			velocityY += gravity * delta;
+		} else if(jumpState > 0) {
+			jumpState = 0;
+			velocityY = 0;
+		} else {
+			jumpState++;
+			velocityY = -jumpStrength;
+		}
+	}
+
+	// Player belongs to the game frame under its center (position is relative to it)
+	if(posX + sizeX / 2 >= width && gameFrame < level.Count()) {
+		gameFrame++;
+		posX -= width;
+		prevX -= width;
+	} else if(posX + sizeX / 2 < 0 && gameFrame > 1) {
+		gameFrame--;
+		posX += width;
+		prevX += width;
+	}
+
+	// Stop player on edges of the world
+	if(gameFrame == level.Count() && posX > width - sizeX) {
+		posX = width - sizeX;
+		if(demo) demoDirection = true;
+	}
+	if(gameFrame == 1 && posX < 1) {
+		posX = 1;
+		if(demo) demoDirection = false;
+	}
+
+	// Prepare the stage on the side the player is heading to
+	if(prefetch) {
+		prefetcher.Request(posX + sizeX / 2 < width / 2 ? gameFrame - 1 : gameFrame + 1);
+	}
+
+	// Move character if it's below bottom barrier of the window
+	if(posY > height - sizeY) {
+		posY = height - sizeY;
+	}
+
+	// On game frame change
+	if(gameFrame != lastGameFrame) {
+		lastGameFrame = gameFrame;
+
+		#ifndef __EMSCRIPTEN__
+			#ifndef NDISCORD
+				// Update Discord Presence
+				strcpy(discord.rpc.details, ("Stage " + NumToStr(gameFrame, 0)).c_str());
+				discord.UpdateRPC();
+			#endif
+		#endif
+	}
+}
+
+int ResolveCollisions() {
+	// Player moved from the previous position, platforms of current game frame and its neighbours stop it
+	if(gridStage != gameFrame) {
+		// Usually built by the prefetcher while the player was heading here
+		if(!prefetcher.Take(gameFrame, stageGrid)) {
+			BuildStageGrid(level, gameFrame, width, gridRects, stageGrid);
+		}
+		gridStage = gameFrame;
+	}
+	double x = prevX, y = prevY;
+	int contacts = stageGrid.Move(x, y, sizeX, sizeY, posX - prevX, posY - prevY);
+	posX = x;
+	posY = y;
+	if(((contacts & CONTACT_GROUND) && velocityY > 0) || ((contacts & CONTACT_CEILING) && velocityY < 0)) {
+		velocityY = 0;
+	}
+	return contacts;
+}
+
+void DrawStage(uint32_t stage) {
+	const LevelStage* data = level.Stage(stage - 1);
+
+	// Render background
+	rect = { 0, 0, width, height };
+	engine.DrawSprite(bgSprite, &rect, data->flags & STAGE_FLIP ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE);
+
+	// Render shapes (above the background)
+	const LevelShape* shapes = level.Shapes(data);
+	for(uint32_t i = 0; i < data->shapeCount; i++) {
+		if(shapes[i].type == SHAPE_TRIANGLE) {
+			engine.BatchTriangle(shapes[i].x, shapes[i].y, shapes[i].color, shapes[i].size, shapes[i].direction, shapes[i].layer);
+		}
+	}
+
+	// Render platforms
+	const SDL_Rect* rects = level.Rects(data);
+	for(uint32_t i = 0; i < data->rectCount; i++) {
+		engine.batch.AddRect(&rects[i], white, LAYER_STAGE);
+	}
+	engine.FlushBatch();
+}
+
+SDL_Texture* GetStageLayer(uint32_t stage) {
+	// Render static content of the game frame once
+	Texture* layer = &stageLayers[stage];
+	if(*layer == NULL) {
+		PROFILE_SCOPE("RenderStageLayer");
+		stageLayersRendered++;
+		layer->Reset(engine.CreateTexture(width, height, SDL_TEXTUREACCESS_TARGET, "Stage layer"));
+		if(*layer == NULL) return NULL;
+		engine.SetTarget(*layer);
+		engine.Clear();
+		DrawStage(stage);
+		engine.SetTarget(NULL);
+		engine.SetColor(white);
+	}
+	return *layer;
 }
 
+void CullStageLayers() {
+	// Free stage layers of chunks away from the camera (only a few are kept however long the level is)
+	for(auto it = stageLayers.begin(); it != stageLayers.end();) {
+		if(!camera.IsNear(it->first - 1)) {
+			it = stageLayers.erase(it);
+		} else {
+			it++;
+		}
+	}
+	if(stageLayers.size() > maxStageLayers) maxStageLayers = stageLayers.size();
+}
+
+void PrefetchStageLayer() {
+	// Chunk near the viewport without layer that is closest to the player
+	uint32_t first, last, chunk = gameFrame - 1, best = 0, bestDistance = 0;
+	if(!camera.Visible(first, last, camera.margin)) return;
+	for(uint32_t i = first; i <= last; i++) {
+		uint32_t distance = (i > chunk ? i - chunk : chunk - i);
+		if(stageLayers.count(i + 1) == 0 && (best == 0 || distance < bestDistance)) {
+			best = i + 1;
+			bestDistance = distance;
+		}
+	}
+	if(best != 0) {
+		PROFILE_SCOPE("PrefetchStageLayer");
+		GetStageLayer(best);
+		stageLayersPrefetched++;
+	}
+}
+
+void DrawPlayer(double x, double y) {
+	// Set player size and position
+	rect.x = x;
+	rect.y = y;
+	rect.w = sizeX;
+	rect.h = sizeY;
+
+	// Render player
+	engine.DrawSprite(playerSprite, &rect, flip, white, LAYER_PLAYER);
+}
+
+void CreateMenus() {
+	// Main menu (buttons are placed in a column)
+	mainMenu.Add(CreateImage(menubgSprite, { 0, 0, width, height }));
+	mainMenu.Add(CreateImage(overlay, { 0, 0, width, height }));
+	Widget* column = mainMenu.Add(new Widget(WIDGET_PANEL, { 300, 200, 200, 170 }));
+	const char* labels[3] = { "Play", "Options", "Exit" };
+	for(int i = 0; i < 3; i++) {
+		menuButtons[i] = column->Add(CreateButton(buttonFont, labels[i], { 0, 60 * i, 200, 50 }, white, green, green, red));
+	}
+
+	// Options
+	optionsMenu.Add(CreateImage(menubgSprite, { 0, 0, width, height }));
+	optionsMenu.Add(CreateImage(overlay, { 0, 0, width, height }));
+	volumeLabel = optionsMenu.Add(CreateLabel(optionFont, "Volume (" + NumToStr(volume, 0) + ")", white, { 10, 30, 0, 0 }));
+	volumeBar = optionsMenu.Add(CreateTrackbar({ 126, 30, 109, 25 }, volume, dimwhite, white, black));
+
+	// Dialog box
+	dialogMenu.Add(CreateImage(menubgSprite, { 0, 0, width, height }));
+	dialogMenu.Add(CreateImage(overlay, { 0, 0, width, height }));
+	dialogText = dialogMenu.Add(CreateLabel(buttonFont, dialogBox.text, white, { 0, 260, 0, 0 }));
+	dialogText->centered = true;
+	dialogButton = dialogMenu.Add(CreateButton(buttonFont, dialogBox.buttonText, { 300, 300, 200, 50 }, white, green, red, red));
+}
+
+bool LoadLevel() {
+	PROFILE_SCOPE("LoadLevel");
+	uint64_t counter = SDL_GetPerformanceCounter();
+
+	// Level from the asset pack or from disk (used in place)
+	const PackEntry* entry = engine.pack.Find("levels/levels.bin");
+	bool loaded = false;
+	if(worldStages > 0) {
+		// Very wide world for benchmarks (same every run)
+		LevelBuilder builder;
+		srand(1);
+		BuildSyntheticLevel(builder, worldStages, 20, 5);
+		std::vector<uint8_t> data = builder.Build();
+		if(!level.Adopt(data)) return false;
+	} else if(!(loaded = (entry != NULL && level.Open(engine.pack.Data(entry), entry->size)) || level.Open("levels/levels.bin"))) {
+		// Built-in stages
+		LevelBuilder builder;
+		builder.AddStage();
+		builder.AddTriangle(690, 200, 100, TRIANGLE_RIGHT, black);
+		builder.AddTriangle(450, 200, 100, TRIANGLE_UP, black);
+		builder.AddTriangle(250, 200, 100, TRIANGLE_DOWN, black);
+		builder.AddTriangle(10, 200, 100, TRIANGLE_LEFT, black);
+		builder.AddRect({ 460, 440, 50, 15 });
+		builder.AddRect({ 630, 540, 60, 15 });
+		builder.AddStage(STAGE_FLIP);
+		builder.AddTriangle(10, 200, 100, TRIANGLE_LEFT, black);
+		builder.AddTriangle(690, 200, 100, TRIANGLE_RIGHT, black);
+		builder.AddRect({ 620, 540, 70, 15 });
+		builder.AddStage();
+		builder.AddTriangle(10, 200, 100, TRIANGLE_LEFT, black);
+		builder.AddRect({ 610, 540, 80, 15 });
+		std::vector<uint8_t> data = builder.Build();
+		if(!level.Adopt(data)) return false;
+	}
+	if(level.Count() == 0) return false;
+	camera.SetWorld(level.Count(), width);
+	prefetcher.Start(&level, width);
+
+	Log("[Startup] Level with " + std::to_string(level.Count()) + " stages " + (loaded ? "loaded" : worldStages > 0 ? "generated" : "built in") + " in " +
+		NumToStr((double)(SDL_GetPerformanceCounter() - counter) * 1000 / SDL_GetPerformanceFrequency(), 3) + " ms");
+	return true;
+}
+
+void Shutdown() {
+	// Free everything while engine is still alive (globals are destroyed after it)
+	#ifndef __EMSCRIPTEN__
+		// Stop reloading assets
+		watcher.Stop();
+	#endif
+	prefetcher.Stop();
+
+	// Destroy resources
+	engine.FreeSprites();
+	overlay.Reset();
+	stageLayers.clear();
+	engine.DestroyGlyphAtlas(counterAtlas);
+	counterAtlas = NULL;
+	mainMenu.Free();
+	optionsMenu.Free();
+	dialogMenu.Free();
+	engine.ClearTextCache();
+
+	// Destroy fonts
+	buttonFont.Reset();
+	optionFont.Reset();
+	counterFont.Reset();
+	engine.ClearPreloaded();
+
+	#ifndef __EMSCRIPTEN__
+		// Destroy sounds
+		bgmusic.Reset();
+	#endif
+}
+
+void BuildSyntheticLevel(LevelBuilder &builder, uint32_t stages, uint32_t platforms, uint32_t shapes) {
+	// Random stages (platforms lie on rows far enough apart that the demo can't get stuck between them)
+	for(uint32_t i = 0; i < stages; i++) {
+		builder.AddStage(i % 2 ? STAGE_FLIP : 0);
+		for(uint32_t j = 0; j < shapes; j++) {
+			builder.AddTriangle(rand() % width, rand() % height, 100, rand() % 4, black);
+		}
+		for(uint32_t j = 0; j < platforms; j++) {
+			builder.AddRect({ rand() % width, height / 4 * (1 + rand() % 3), 40 + rand() % 80, 15 });
+		}
+	}
+}
+
+#ifndef __EMSCRIPTEN__
+	bool LoadAssets() {
+		PROFILE_SCOPE("LoadAssets");
+		AssetLoader loader(&engine.pack);
+
+		// Queue atlas pages (or loose images without atlas), fonts and sounds
+		std::vector<std::string> pages = engine.GetAtlasPages("images/atlas.txt");
+		for(auto const &page: pages) {
+			loader.Add(LOAD_IMAGE, page.c_str());
+		}
+		if(pages.empty()) {
+			loader.Add(LOAD_IMAGE, "images/bg.png");
+			loader.Add(LOAD_IMAGE, "images/menubg.png");
+			loader.Add(LOAD_IMAGE, "images/player.png");
+		}
+		loader.Add(LOAD_FILE, "fonts/DroidSans.ttf");
+		loader.Add(LOAD_FILE, "fonts/Visitor2.ttf");
+		loader.Start(loadThreads);
+
+		// Upload results as they arrive, show progress while waiting
+		while(!loader.Done()) {
+			LoadJob* job = loader.Next();
+			if(job == NULL) {
+				DrawLoading(loader.Finished(), loader.Total());
+				SDL_PumpEvents();
+				SDL_Delay(1);
+			} else if(job->failed) {
+				DisplayError("Can't load required assets (" + job->path + ": " + job->error + ")");
+				return false;
+			} else {
+				engine.Preload(job);
+			}
+		}
+		loader.Join();
+
+		Log("[Startup] Loaded " + std::to_string(loader.Total()) + " assets on " + std::to_string(loader.threads) + " threads in " +
+			NumToStr(loader.seconds * 1000) + " ms");
+		return true;
+	}
+
+	void DrawLoading(size_t done, size_t total) {
+		if(noRender) return;
+
+		// Progress bar in the middle of the window
+		SDL_Rect bar = { width / 4, height / 2 - 10, width / 2, 20 };
+		engine.SetColor(black);
+		engine.Clear();
+		engine.batch.AddRect(&bar, dimwhite);
+		bar.w = (total > 0 ? bar.w * done / total : 0);
+		engine.batch.AddRect(&bar, green);
+		engine.Present();
+		engine.SetColor(white);
+	}
+
+	void ApplyReloads() {
+		PROFILE_SCOPE("ApplyReloads");
+		// Fonts opened from each font file
+		struct { Font* font; const char* path; int size; } fonts[] = {
+			{ &buttonFont, "fonts/DroidSans.ttf", 22 },
+			{ &optionFont, "fonts/DroidSans.ttf", 18 },
+			{ &counterFont, "fonts/Visitor2.ttf", 25 }
+		};
+
+		while(LoadJob* job = watcher.Next()) {
+			if(job->failed) {
+				Log("[Watch] Can't reload " + job->path + " (" + job->error + ")");
+			} else if(job->type == LOAD_IMAGE) {
+				if(engine.ReloadTexture(job)) {
+					// Drop everything drawn from the old image
+					stageLayers.clear();
+					mainMenu.Free();
+					optionsMenu.Free();
+					dialogMenu.Free();
+					Log("[Watch] Reloaded " + job->path);
+				}
+			} else if(job->type == LOAD_FILE) {
+				// Open every size first, old fonts are kept if any of them fails
+				TTF_Font* opened[3] = { NULL, NULL, NULL };
+				bool used = false, ok = true;
+				for(int i = 0; i < 3; i++) {
+					if(job->path != fonts[i].path) continue;
+					used = true;
+					opened[i] = engine.LoadFont(SDL_RWFromConstMem(job->data.data(), job->data.size()), fonts[i].size, fonts[i].path);
+					if(opened[i] == NULL) ok = false;
+				}
+				if(!ok) {
+					for(int i = 0; i < 3; i++) {
+						if(opened[i] != NULL) DestroyResource(opened[i]);
+					}
+					Log("[Watch] Can't reload " + job->path + " (" + std::string(TTF_GetError()) + ")");
+				} else if(used) {
+					engine.ClearTextCache();
+					for(int i = 0; i < 3; i++) {
+						if(opened[i] == NULL) continue;
+						mainMenu.ReplaceFont(*fonts[i].font, opened[i]);
+						optionsMenu.ReplaceFont(*fonts[i].font, opened[i]);
+						dialogMenu.ReplaceFont(*fonts[i].font, opened[i]);
+						fonts[i].font->Reset(opened[i]);
+					}
+					if(opened[2] != NULL) {
+						GlyphAtlas* atlas = engine.CreateGlyphAtlas(counterFont);
+						if(atlas != NULL) {
+							engine.DestroyGlyphAtlas(counterAtlas);
+							counterAtlas = atlas;
+						}
+					}
+
+					// New fonts read from the job data, engine keeps it (old data goes away with the job)
+					engine.Preload(job);
+					Log("[Watch] Reloaded " + job->path);
+				}
+			}
+			watcher.Done(job);
+		}
+	}
+
+	bool ShowBenchmark() {
+		if(benchTimes.empty()) {
+			return true;
+		}
+
+		// Get frame time percentiles
+		std::vector<double> times = benchTimes;
+		std::sort(times.begin(), times.end());
+		double total = 0;
+		for(auto const &time: times) {
+			total += time;
+		}
+		double percentiles[4] = {
+			times[(times.size() - 1) * 50 / 100],
+			times[(times.size() - 1) * 90 / 100],
+			times[(times.size() - 1) * 99 / 100],
+			times.back()
+		};
+		const char* names[4] = { "p50", "p90", "p99", "max" };
+
+		std::cout << "Benchmark: " << times.size() << " frames in " << NumToStr(total / 1000, 3) << " s (" << NumToStr(times.size() * 1000 / total, 0) << " FPS)" << std::endl;
+		std::cout << "Frame time:";
+		for(int i = 0; i < 4; i++) {
+			std::cout << " " << names[i] << " " << NumToStr(percentiles[i], 3) << " ms" << (i < 3 ? "," : "");
+		}
+		std::cout << std::endl;
+		std::cout << "World: " << level.Count() << " stages (" << (uint64_t)level.Count() * width << " px), " << NumToStr((double)chunksDrawn / times.size(), 2) <<
+			" chunks drawn per frame, " << maxStageLayers << " stage layers kept at most, reached stage " << gameFrame << std::endl;
+
+		// Compare frames where the stage or the chunks in view changed with the others
+		const double bounds[7] = { 0.5, 1, 2, 4, 8, 16, 33 };
+		uint32_t histogram[2][8] = {};
+		double transitionMax = 0, otherMax = 0;
+		for(size_t i = 0, next = 0; i < benchTimes.size(); i++) {
+			bool transition = (next < benchTransitions.size() && benchTransitions[next] == i);
+			if(transition) next++;
+			int bucket = 0;
+			while(bucket < 7 && benchTimes[i] >= bounds[bucket]) bucket++;
+			histogram[transition ? 0 : 1][bucket]++;
+			double &max = (transition ? transitionMax : otherMax);
+			if(benchTimes[i] > max) max = benchTimes[i];
+		}
+		std::cout << "Transitions: " << benchTransitions.size() << " frames, " << stageLayersPrefetched << " stage layers rendered ahead, " <<
+			prefetcher.hits << "/" << prefetcher.hits + prefetcher.misses << " stage grids prefetched" << (prefetch ? "" : " (prefetch off)") << std::endl;
+		char line[64];
+		std::cout << "  frame time     transitions     others" << std::endl;
+		for(int i = 0; i < 8; i++) {
+			snprintf(line, sizeof(line), "  %-2s %-5g ms %15u %10u", i < 7 ? "<" : ">=", bounds[i < 7 ? i : 6], histogram[0][i], histogram[1][i]);
+			std::cout << line << std::endl;
+		}
+		snprintf(line, sizeof(line), "  max (ms) %18.3f %10.3f", transitionMax, otherMax);
+		std::cout << line << std::endl;
+
+		// Show time spent in profiler zones per frame
+		double freq = SDL_GetPerformanceFrequency() / 1000.0;
+		auto phases = profiler.Totals();
+		std::cout << "Phase time (per frame):" << std::endl;
+		for(auto const &phase: phases) {
+			std::cout << "  " << phase.name << ": " << NumToStr(phase.ticks / freq / times.size(), 4) << " ms (" << phase.count << " calls)" << std::endl;
+		}
+
+		if(benchPath.empty()) {
+			return true;
+		}
+
+		// Save results as JSON
+		FILE* file = fopen(benchPath.c_str(), "w");
+		if(file == NULL) {
+			return false;
+		}
+		fprintf(file, "{\n\t\"version\": \"%s\",\n\t\"frames\": %u,\n\t\"time\": %.6f,\n\t\"frame_time_ms\": {", version, (uint32_t)times.size(), total / 1000);
+		for(int i = 0; i < 4; i++) {
+			fprintf(file, "%s\"%s\": %.6f", i > 0 ? ", " : "", names[i], percentiles[i]);
+		}
+		fprintf(file, "},\n\t\"world\": { \"stages\": %u, \"chunks_per_frame\": %.6f, \"max_stage_layers\": %u },", level.Count(),
+			(double)chunksDrawn / times.size(), (uint32_t)maxStageLayers);
+		fprintf(file, "\n\t\"transitions\": { \"frames\": %u, \"max_ms\": %.6f, \"other_max_ms\": %.6f, \"prefetch\": %s, \"layers_ahead\": %llu, \"grids_prefetched\": %llu },",
+			(uint32_t)benchTransitions.size(), transitionMax, otherMax, prefetch ? "true" : "false", (unsigned long long)stageLayersPrefetched, (unsigned long long)prefetcher.hits);
+		fputs("\n\t\"phases_ms\": {", file);
+		for(size_t i = 0; i < phases.size(); i++) {
+			fprintf(file, "%s\n\t\t\"%s\": { \"per_frame\": %.6f, \"total\": %.6f, \"calls\": %llu }", i > 0 ? "," : "", phases[i].name.c_str(),
+				phases[i].ticks / freq / times.size(), phases[i].ticks / freq, (unsigned long long)phases[i].count);
+		}
+		fputs("\n\t}\n}\n", file);
+		return fclose(file) == 0;
+	}
+
+	bool BenchCollision() {
+		// Stages get wider with the same platform density (16 platforms per screen)
+		const uint32_t queries = 200000;
+		const size_t counts[4] = { 16, 256, 4096, 65536 };
+		double freq = SDL_GetPerformanceFrequency();
+		srand(1);
+		std::cout << "Collision benchmark: " << queries << " player-sized areas per stage" << std::endl;
+		bool match = true;
+		for(auto count: counts) {
+			int stageWidth = width * count / 16;
+			std::vector<SDL_Rect> platforms(count);
+			for(auto &platform: platforms) {
+				platform = { rand() % stageWidth, 100 + rand() % (height - 100), 40 + rand() % 80, 15 };
+			}
+
+			// Same moves for grid and linear scan (queries cover the box before and after each move, as Move does)
+			std::vector<double> moves(queries * 4);
+			std::vector<SDL_Rect> areas(queries);
+			for(uint32_t i = 0; i < queries; i++) {
+				moves[i * 4] = rand() % stageWidth;
+				moves[i * 4 + 1] = rand() % height;
+				moves[i * 4 + 2] = rand() % 29 - 14;
+				moves[i * 4 + 3] = rand() % 29 - 14;
+				int x = moves[i * 4] + std::min(moves[i * 4 + 2], 0.0), y = moves[i * 4 + 1] + std::min(moves[i * 4 + 3], 0.0);
+				areas[i] = { x, y, sizeX + (int)std::abs(moves[i * 4 + 2]) + 1, sizeY + (int)std::abs(moves[i * 4 + 3]) + 1 };
+			}
+
+			uint64_t counter = SDL_GetPerformanceCounter();
+			CollisionGrid grid;
+			grid.Build(platforms.data(), platforms.size());
+			double buildTime = (SDL_GetPerformanceCounter() - counter) / freq;
+
+			// Grid query (fewer areas are also scanned linearly on big stages, their results must match)
+			uint32_t linearQueries = std::min<uint64_t>(queries, 100000000 / count);
+			std::vector<uint32_t> found;
+			uint64_t gridFound = 0, gridChecked = 0;
+			counter = SDL_GetPerformanceCounter();
+			for(uint32_t i = 0; i < queries; i++) {
+				gridFound += grid.Query(areas[i], found);
+				if(i + 1 == linearQueries) gridChecked = gridFound;
+			}
+			double gridTime = (SDL_GetPerformanceCounter() - counter) / freq;
+
+			// Full linear scan over every platform (no early exit, same output as the grid)
+			uint64_t linearFound = 0;
+			counter = SDL_GetPerformanceCounter();
+			for(uint32_t i = 0; i < linearQueries; i++) {
+				const SDL_Rect &area = areas[i];
+				found.clear();
+				for(uint32_t j = 0; j < count; j++) {
+					const SDL_Rect &r = platforms[j];
+					if(area.x < r.x + r.w && area.x + area.w > r.x && area.y < r.y + r.h && area.y + area.h > r.y) {
+						found.push_back(j);
+					}
+				}
+				linearFound += found.size();
+			}
+			double linearTime = (SDL_GetPerformanceCounter() - counter) / freq;
+			if(linearFound != gridChecked) match = false;
+
+			// Full moves (up to COLLISION_PASSES queries each)
+			counter = SDL_GetPerformanceCounter();
+			uint32_t contacts = 0;
+			for(uint32_t i = 0; i < queries; i++) {
+				double x = moves[i * 4], y = moves[i * 4 + 1];
+				if(grid.Move(x, y, sizeX, sizeY, moves[i * 4 + 2], moves[i * 4 + 3]) != 0) contacts++;
+			}
+			double moveTime = (SDL_GetPerformanceCounter() - counter) / freq;
+
+			std::cout << "  " << count << " platforms (" << stageWidth << " px): build " << NumToStr(buildTime * 1000, 3) << " ms, grid " <<
+				NumToStr(queries / gridTime / 1000000, 3) << " M queries/s (" << NumToStr((double)grid.tests / grid.queries, 1) << " tests per query), linear " <<
+				NumToStr(linearQueries / linearTime / 1000000, 3) << " M queries/s, " << gridChecked << "/" << linearFound << " found (" <<
+				(linearFound == gridChecked ? "match" : "MISMATCH") << "), moves " << NumToStr(queries / moveTime / 1000000, 2) << " M/s (" << contacts << " contacts)" << std::endl;
+		}
+
+		// Move towards a thin platform (down, up) or wall (right, left) at every speed and tick rate, box must never pass it
+		const double speeds[7] = { 100, 350, 700, 1400, 5000, 20000, 100000 };
+		const uint32_t rates[4] = { 10, 20, 50, 120 };
+		const int thicknesses[2] = { 1, 15 };
+		uint32_t moves = 0, passed = 0;
+		for(auto thick: thicknesses) {
+			SDL_Rect blocks[2] = { { -200, 1000, 800, thick }, { 1000, -200, thick, 800 } };
+			for(int direction = 0; direction < 4; direction++) {
+				CollisionGrid grid;
+				grid.Build(&blocks[direction / 2], 1);
+				for(auto speed: speeds) {
+					for(auto rate: rates) {
+						for(int i = 0; i < 50; i++) {
+							double gap = rand() % 200 + (rand() % 100) / 100.0, side = rand() % 300;
+							double x = side, y = side;
+							switch(direction) {
+								case 0: y = 1000 - sizeY - gap; break;
+								case 1: y = 1000 + thick + gap; break;
+								case 2: x = 1000 - sizeX - gap; break;
+								case 3: x = 1000 + thick + gap; break;
+							}
+							for(int tick = 0; tick < 10; tick++) {
+								double step = speed / rate, jitter = rand() % 29 - 14;
+								grid.Move(x, y, sizeX, sizeY, direction < 2 ? jitter : (direction == 2 ? step : -step),
+									direction < 2 ? (direction == 0 ? step : -step) : jitter);
+								moves++;
+								bool through = (direction == 0 ? y + sizeY > 1000 : direction == 1 ? y < 1000 + thick :
+									direction == 2 ? x + sizeX > 1000 : x < 1000 + thick);
+								if(through) {
+									passed++;
+									break;
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+		std::cout << "Tunnelling check: " << moves << " moves at " << speeds[0] << "-" << speeds[6] << " px/s and " << rates[0] << "-" << rates[3] <<
+			" ticks/s, " << passed << " passed through (" << (passed == 0 ? "OK" : "FAILED") << ")" << std::endl;
+		return match && passed == 0;
+	}
+
+	bool BenchLevel() {
+		// Synthetic level with many stages (written next to the game and removed afterwards)
+		const uint32_t stages = 10000, platforms = 20, shapes = 5, opens = 20;
+		const char* path = "bench_level.bin";
+		double freq = SDL_GetPerformanceFrequency();
+		srand(1);
+		uint64_t counter = SDL_GetPerformanceCounter();
+		LevelBuilder builder;
+		BuildSyntheticLevel(builder, stages, platforms, shapes);
+		if(!builder.Save(path)) {
+			std::cerr << "Can't write " << path << std::endl;
+			return false;
+		}
+		double saveTime = (SDL_GetPerformanceCounter() - counter) / freq;
+
+		// Opening maps the file and checks the stage table
+		Level bench;
+		counter = SDL_GetPerformanceCounter();
+		bool ok = true;
+		for(uint32_t i = 0; i < opens && ok; i++) {
+			ok = bench.Open(path) && bench.Count() == stages;
+		}
+		double openTime = (SDL_GetPerformanceCounter() - counter) / freq / opens;
+
+		// Entering a stage reads its platforms in place and builds the collision grid
+		CollisionGrid grid;
+		uint64_t total = 0;
+		counter = SDL_GetPerformanceCounter();
+		for(uint32_t i = 0; i < 1000 && ok; i++) {
+			const LevelStage* stage = bench.Stage(rand() % stages);
+			ok = (stage != NULL && stage->rectCount == platforms && stage->shapeCount == shapes);
+			if(ok) {
+				grid.Build(bench.Rects(stage), stage->rectCount);
+				total += grid.Count();
+			}
+		}
+		double enterTime = (SDL_GetPerformanceCounter() - counter) / freq / 1000;
+		size_t size = bench.Size();
+		bench.Close();
+		remove(path);
+		if(!ok) {
+			std::cerr << "Level benchmark failed (can't read back " << path << ")" << std::endl;
+			return false;
+		}
+
+		std::cout << "Level benchmark: " << stages << " stages, " << stages * platforms << " platforms, " << stages * shapes << " shapes (" <<
+			NumToStr(size / 1048576.0, 2) << " MB)" << std::endl;
+		std::cout << "  build and save " << NumToStr(saveTime * 1000, 2) << " ms, open " << NumToStr(openTime * 1000, 3) << " ms (average of " << opens <<
+			"), stage entry " << NumToStr(enterTime * 1000000, 2) << " us (" << total << " platforms read)" << std::endl;
+		return true;
+	}
+#endif
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #ifndef __EMSCRIPTEN__
@@ -1136,3 +1861,4 @@ void Frame() {
 		}
 	#endif
 #endif
+
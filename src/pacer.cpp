@@ -0,0 +1,122 @@
+#include "../include/pacer.hpp"
+
+// Oversleep histogram bucket upper bounds in milliseconds (last bucket is unbounded)
+static const double bucketLimits[PACER_BUCKETS - 1] = { 0.1, 0.25, 0.5, 1, 2, 4 };
+
+Pacer::Pacer(int mode, uint32_t rate) {
+	this->freq = SDL_GetPerformanceFrequency();
+	this->deadline = 0;
+	this->spin = this->freq / 500; // Start with 2 ms of spinning
+	this->sleepError = 0;
+	this->SetMode(mode, rate);
+	this->ResetStats();
+}
+
+void Pacer::SetMode(int mode, uint32_t rate) {
+	this->mode = mode;
+	if(rate > 0) this->rate = rate;
+	this->period = (this->mode == PACER_CAPPED && this->rate > 0 ? this->freq / this->rate : 0);
+	this->deadline = 0;
+}
+
+void Pacer::Wait() {
+	uint64_t now = SDL_GetPerformanceCounter();
+	this->frames++;
+
+	// Vsync and uncapped modes don't wait (presenting blocks in vsync mode)
+	if(this->period == 0) {
+		return;
+	}
+
+	// First frame, start counting deadlines from now
+	if(this->deadline == 0) {
+		this->deadline = now + this->period;
+		return;
+	}
+
+	// Frame took longer than its period, start again from now
+	if(now >= this->deadline) {
+		this->missed++;
+		this->deadline = now + this->period;
+		return;
+	}
+
+	// Sleep coarsely, leaving the last part for spinning
+	while(this->deadline - now > this->spin) {
+		uint32_t ms = (this->deadline - now - this->spin) * 1000 / this->freq;
+		if(ms == 0) break;
+
+		uint64_t before = now;
+		SDL_Delay(ms);
+		now = SDL_GetPerformanceCounter();
+
+		// Track how much longer than requested the sleep took
+		uint64_t slept = now - before;
+		uint64_t requested = (uint64_t)ms * this->freq / 1000;
+		uint64_t error = (slept > requested ? slept - requested : 0);
+		this->sleepError = (this->sleepError * 7 + error) / 8;
+		if(now >= this->deadline) break;
+	}
+
+	// Adapt spinning time to the scheduler accuracy (between 0.5 ms and 4 ms)
+	this->spin = this->sleepError * 2;
+	if(this->spin < this->freq / 2000) this->spin = this->freq / 2000;
+	if(this->spin > this->freq / 250) this->spin = this->freq / 250;
+
+	// Spin for the remaining time
+	while(now < this->deadline) {
+		now = SDL_GetPerformanceCounter();
+	}
+
+	// Record oversleep
+	double late = (double)(now - this->deadline) * 1000 / this->freq;
+	int bucket = 0;
+	while(bucket < PACER_BUCKETS - 1 && late >= bucketLimits[bucket]) bucket++;
+	this->oversleep[bucket]++;
+	if(late > this->maxOversleep) this->maxOversleep = late;
+
+	// Next deadline is relative to the previous one, so errors don't accumulate
+	this->deadline += this->period;
+}
+
+void Pacer::ResetStats() {
+	this->frames = 0;
+	this->missed = 0;
+	for(int i = 0; i < PACER_BUCKETS; i++) {
+		this->oversleep[i] = 0;
+	}
+	this->maxOversleep = 0;
+}
+
+std::string Pacer::Report() {
+	std::string out = "Frames: " + std::to_string(this->frames);
+	switch(this->mode) {
+		case PACER_CAPPED:
+			out += " (capped at " + std::to_string(this->rate) + " Hz)";
+			break;
+		case PACER_VSYNC:
+			out += " (vsync)";
+			break;
+		case PACER_UNCAPPED:
+			out += " (uncapped)";
+			break;
+	}
+	if(this->period == 0) {
+		return out;
+	}
+
+	out += ", missed deadlines: " + std::to_string(this->missed) + ", oversleep:";
+	for(int i = 0; i < PACER_BUCKETS; i++) {
+		char str[32];
+		if(i < PACER_BUCKETS - 1) {
+			snprintf(str, 32, " <%gms: %llu", bucketLimits[i], (unsigned long long)this->oversleep[i]);
+		} else {
+			snprintf(str, 32, " >=%gms: %llu", bucketLimits[i - 1], (unsigned long long)this->oversleep[i]);
+		}
+		out += str;
+	}
+
+	char str[32];
+	snprintf(str, 32, ", max: %.3fms", this->maxOversleep);
+	return out + str;
+}
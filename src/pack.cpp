@@ -0,0 +1,189 @@
+#include <cstring>
+#include "../include/pack.hpp"
+#include "../include/profiler.hpp"
+#if defined(_WIN32)
+	#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile() {
+	this->data = NULL;
+	this->size = 0;
+	#ifdef _WIN32
+		this->file = NULL;
+		this->mapping = NULL;
+	#endif
+}
+
+MappedFile::~MappedFile() {
+	this->Close();
+}
+
+bool MappedFile::Open(const char* path) {
+	this->Close();
+
+	// Map the whole file (pages are loaded by the OS when they are used)
+	#if defined(_WIN32)
+		this->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if(this->file == INVALID_HANDLE_VALUE) {
+			this->file = NULL;
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		if(GetFileSizeEx(this->file, &fileSize)) {
+			this->mapping = CreateFileMappingA(this->file, NULL, PAGE_READONLY, 0, 0, NULL);
+		}
+		if(this->mapping != NULL) {
+			this->data = (const uint8_t*)MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0);
+			this->size = fileSize.QuadPart;
+		}
+	#elif !defined(__EMSCRIPTEN__)
+		int fd = open(path, O_RDONLY);
+		if(fd < 0) return false;
+		struct stat st;
+		if(fstat(fd, &st) == 0 && st.st_size > 0) {
+			void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if(addr != MAP_FAILED) {
+				this->data = (const uint8_t*)addr;
+				this->size = st.st_size;
+			}
+		}
+		close(fd);
+	#else
+		// No mmap in the browser, read the file into memory
+		SDL_RWops* rw = SDL_RWFromFile(path, "rb");
+		if(rw == NULL) return false;
+		Sint64 fileSize = SDL_RWsize(rw);
+		if(fileSize > 0) {
+			uint8_t* buffer = new uint8_t[fileSize];
+			if(SDL_RWread(rw, buffer, fileSize, 1) == 1) {
+				this->data = buffer;
+				this->size = fileSize;
+			} else {
+				delete[] buffer;
+			}
+		}
+		SDL_RWclose(rw);
+	#endif
+	if(this->data == NULL) {
+		this->Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close() {
+	if(this->data != NULL) {
+		#if defined(_WIN32)
+			UnmapViewOfFile(this->data);
+		#elif !defined(__EMSCRIPTEN__)
+			munmap((void*)this->data, this->size);
+		#else
+			delete[] this->data;
+		#endif
+	}
+	#ifdef _WIN32
+		if(this->mapping != NULL) CloseHandle(this->mapping);
+		if(this->file != NULL) CloseHandle(this->file);
+		this->mapping = NULL;
+		this->file = NULL;
+	#endif
+	this->data = NULL;
+	this->size = 0;
+}
+
+const uint8_t* MappedFile::Data() {
+	return this->data;
+}
+
+size_t MappedFile::Size() {
+	return this->size;
+}
+
+void MappedFile::Prefetch(const void* data, size_t size) {
+	// Ask the OS to read pages of a mapped range ahead (only a hint, pages are loaded on use anyway)
+	if(data == NULL || size == 0) return;
+	#if defined(_WIN32)
+		#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+			WIN32_MEMORY_RANGE_ENTRY range = { (PVOID)data, size };
+			PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+		#endif
+	#elif !defined(__EMSCRIPTEN__)
+		uintptr_t page = sysconf(_SC_PAGESIZE);
+		uintptr_t start = (uintptr_t)data & ~(page - 1);
+		madvise((void*)start, (uintptr_t)data + size - start, MADV_WILLNEED);
+	#endif
+}
+
+static bool ValidEntry(const PackEntry &entry, size_t size) {
+	if(entry.offset > size || entry.size > size - entry.offset) return false;
+	if(entry.type != PACK_PIXELS) return true;
+
+	// Decoded images are used in place, rows must fit in the entry
+	uint64_t bpp = (SDL_ISPIXELFORMAT_FOURCC(entry.format) ? 0 : SDL_BYTESPERPIXEL(entry.format));
+	return bpp > 0 && entry.width > 0 && entry.height > 0 && entry.pitch >= entry.width * bpp &&
+		(uint64_t)entry.pitch * entry.height <= entry.size;
+}
+
+AssetPack::~AssetPack() {
+	this->Close();
+}
+
+bool AssetPack::Open(const char* path) {
+	PROFILE_SCOPE("OpenPack");
+	this->Close();
+	if(!this->file.Open(path)) return false;
+
+	// Check header and table of contents
+	const uint8_t* data = this->file.Data();
+	size_t size = this->file.Size();
+	const PackHeader* header = (const PackHeader*)data;
+	if(size < sizeof(PackHeader) || memcmp(header->magic, PACK_MAGIC, 4) != 0 || header->version != PACK_VERSION ||
+		header->count > (size - sizeof(PackHeader)) / sizeof(PackEntry)) {
+		this->Close();
+		return false;
+	}
+	const PackEntry* toc = (const PackEntry*)(data + sizeof(PackHeader));
+	for(uint32_t i = 0; i < header->count; i++) {
+		if(!ValidEntry(toc[i], size)) {
+			this->Close();
+			return false;
+		}
+		std::string name(toc[i].name, strnlen(toc[i].name, PACK_NAME_SIZE));
+		this->entries[name] = &toc[i];
+	}
+	return true;
+}
+
+void AssetPack::Close() {
+	this->file.Close();
+	this->entries.clear();
+}
+
+bool AssetPack::IsOpen() {
+	return this->file.Data() != NULL;
+}
+
+const PackEntry* AssetPack::Find(const std::string &name) {
+	auto it = this->entries.find(name);
+	return (it != this->entries.end() ? it->second : NULL);
+}
+
+const void* AssetPack::Data(const PackEntry* entry) {
+	return (entry != NULL ? this->file.Data() + entry->offset : NULL);
+}
+
+SDL_RWops* AssetPack::Read(const std::string &name) {
+	// Serve the entry straight from the pack memory (no copy)
+	const PackEntry* entry = this->Find(name);
+	if(entry == NULL) return NULL;
+	return SDL_RWFromConstMem(this->Data(entry), entry->size);
+}
+
+size_t AssetPack::Count() {
+	return this->entries.size();
+}
@@ -0,0 +1,106 @@
+#include <utility>
+#include "../include/prefetch.hpp"
+
+void BuildStageGrid(Level &level, uint32_t stage, int width, std::vector<SDL_Rect> &rects, CollisionGrid &grid) {
+	rects.clear();
+	for(uint32_t i = (stage > 1 ? stage - 1 : 1); i <= stage + 1 && i <= level.Count(); i++) {
+		const LevelStage* data = level.Stage(i - 1);
+		const SDL_Rect* stageRects = level.Rects(data);
+		int offset = ((int)i - (int)stage) * width;
+		for(uint32_t j = 0; j < data->rectCount; j++) {
+			rects.push_back({ stageRects[j].x + offset, stageRects[j].y, stageRects[j].w, stageRects[j].h });
+		}
+	}
+	grid.Build(rects.data(), rects.size());
+}
+
+StagePrefetcher::StagePrefetcher() {
+	this->level = NULL;
+	this->width = 0;
+	this->running = false;
+	this->wanted = 0;
+	this->building = 0;
+	this->ready = 0;
+	this->hits = 0;
+	this->misses = 0;
+}
+
+StagePrefetcher::~StagePrefetcher() {
+	this->Stop();
+}
+
+void StagePrefetcher::Start(Level* level, int width) {
+	this->Stop();
+	this->level = level;
+	this->width = width;
+	#ifndef __EMSCRIPTEN__
+		this->running = true;
+		this->thread = std::thread(&StagePrefetcher::Work, this);
+	#endif
+}
+
+void StagePrefetcher::Stop() {
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->running = false;
+		this->wanted = 0;
+		this->ready = 0;
+	}
+	this->wake.notify_one();
+	if(this->thread.joinable()) {
+		this->thread.join();
+	}
+	this->level = NULL;
+}
+
+void StagePrefetcher::Build(uint32_t stage) {
+	// Shapes are needed when the stage layer is rendered
+	this->level->Prefetch(this->level->Stage(stage - 1));
+	BuildStageGrid(*this->level, stage, this->width, this->rects, this->spare);
+
+	std::lock_guard<std::mutex> guard(this->lock);
+	std::swap(this->grid, this->spare);
+	this->ready = stage;
+}
+
+void StagePrefetcher::Work() {
+	std::unique_lock<std::mutex> guard(this->lock);
+	while(true) {
+		this->wake.wait(guard, [this] { return !this->running || this->wanted != 0; });
+		if(!this->running) return;
+		this->building = this->wanted;
+		this->wanted = 0;
+		guard.unlock();
+		this->Build(this->building);
+		guard.lock();
+		this->building = 0;
+	}
+}
+
+void StagePrefetcher::Request(uint32_t stage) {
+	if(this->level == NULL || stage < 1 || stage > this->level->Count()) return;
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		if(stage == this->ready || stage == this->wanted || stage == this->building) return;
+		this->wanted = stage;
+	}
+	if(this->running) {
+		this->wake.notify_one();
+	} else {
+		// Without worker the stage is built right away (still before the player gets there)
+		this->wanted = 0;
+		this->Build(stage);
+	}
+}
+
+bool StagePrefetcher::Take(uint32_t stage, CollisionGrid &grid) {
+	std::lock_guard<std::mutex> guard(this->lock);
+	if(stage != this->ready) {
+		this->misses++;
+		return false;
+	}
+	std::swap(grid, this->grid);
+	this->ready = 0;
+	this->hits++;
+	return true;
+}
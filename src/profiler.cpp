@@ -0,0 +1,123 @@
+#include <cstdio>
+#include <algorithm>
+#include "../include/profiler.hpp"
+
+Profiler profiler;
+
+// Buffer of the current thread
+static thread_local ProfileBuffer* threadBuffer = NULL;
+
+Profiler::Profiler() {
+	this->enabled = false;
+}
+
+Profiler::~Profiler() {
+	for(auto buffer: this->buffers) {
+		delete buffer;
+	}
+}
+
+ProfileBuffer* Profiler::GetBuffer() {
+	if(threadBuffer == NULL) {
+		std::lock_guard<std::mutex> guard(this->lock);
+		threadBuffer = new ProfileBuffer();
+		threadBuffer->thread = this->buffers.size() + 1;
+		threadBuffer->count = 0;
+		threadBuffer->folded = 0;
+		this->buffers.push_back(threadBuffer);
+	}
+	return threadBuffer;
+}
+
+static void AddTotal(std::map<const char*, ProfileTotal> &totals, const ProfileEvent &event) {
+	ProfileTotal* total = &totals[event.name];
+	total->ticks += event.end - event.start;
+	total->count++;
+}
+
+void Profiler::Record(const char* name, uint64_t start, uint64_t end) {
+	ProfileBuffer* buffer = this->GetBuffer();
+	uint64_t count = buffer->count.load(std::memory_order_relaxed);
+
+	// Sum zone time of the whole buffer before it wraps (so totals aren't limited by buffer size)
+	if(count - buffer->folded == PROFILER_BUFFER_SIZE) {
+		for(uint64_t i = buffer->folded; i < count; i++) {
+			AddTotal(buffer->totals, buffer->events[i % PROFILER_BUFFER_SIZE]);
+		}
+		buffer->folded = count;
+	}
+
+	ProfileEvent* event = &buffer->events[count % PROFILER_BUFFER_SIZE];
+	event->name = name;
+	event->start = start;
+	event->end = end;
+	buffer->count.store(count + 1, std::memory_order_release);
+}
+
+std::vector<ProfileTotal> Profiler::Totals() {
+	std::map<std::string, ProfileTotal> merged;
+
+	// Merge totals of all threads by zone name (with events not summed yet)
+	std::lock_guard<std::mutex> guard(this->lock);
+	for(auto buffer: this->buffers) {
+		std::map<const char*, ProfileTotal> totals = buffer->totals;
+		uint64_t count = buffer->count.load(std::memory_order_acquire);
+		for(uint64_t i = buffer->folded; i < count; i++) {
+			AddTotal(totals, buffer->events[i % PROFILER_BUFFER_SIZE]);
+		}
+		for(auto const &item: totals) {
+			ProfileTotal* total = &merged[item.first];
+			total->name = item.first;
+			total->ticks += item.second.ticks;
+			total->count += item.second.count;
+		}
+	}
+
+	// Sort by time spent
+	std::vector<ProfileTotal> out;
+	for(auto const &item: merged) {
+		out.push_back(item.second);
+	}
+	std::sort(out.begin(), out.end(), [](const ProfileTotal &a, const ProfileTotal &b) {
+		return a.ticks > b.ticks;
+	});
+	return out;
+}
+
+bool Profiler::Export(const char* path) {
+	FILE* file = fopen(path, "w");
+	if(file == NULL) {
+		return false;
+	}
+
+	// Timestamps are written in microseconds relative to the oldest event
+	double freq = SDL_GetPerformanceFrequency() / 1000000.0;
+	uint64_t origin = UINT64_MAX;
+
+	std::lock_guard<std::mutex> guard(this->lock);
+	for(auto buffer: this->buffers) {
+		uint64_t count = buffer->count.load(std::memory_order_acquire);
+		uint64_t first = (count > PROFILER_BUFFER_SIZE ? count - PROFILER_BUFFER_SIZE : 0);
+		for(uint64_t i = first; i < count; i++) {
+			uint64_t start = buffer->events[i % PROFILER_BUFFER_SIZE].start;
+			if(start < origin) origin = start;
+		}
+	}
+
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+	bool first = true;
+	for(auto buffer: this->buffers) {
+		uint64_t count = buffer->count.load(std::memory_order_acquire);
+		uint64_t i = (count > PROFILER_BUFFER_SIZE ? count - PROFILER_BUFFER_SIZE : 0);
+		for(; i < count; i++) {
+			ProfileEvent* event = &buffer->events[i % PROFILER_BUFFER_SIZE];
+			fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				first ? "" : ",", event->name, buffer->thread,
+				(event->start - origin) / freq, (event->end - event->start) / freq);
+			first = false;
+		}
+	}
+	fputs("\n]}\n", file);
+
+	return fclose(file) == 0;
+}
@@ -0,0 +1,85 @@
+#include "../include/registry.hpp"
+
+ResourceRegistry registry;
+
+static const char* typeNames[RESOURCE_TYPES] = { "textures", "fonts", "sounds", "music" };
+
+ResourceRegistry::ResourceRegistry() {
+	for(int i = 0; i < RESOURCE_TYPES; i++) {
+		this->count[i] = 0;
+		this->bytes[i] = 0;
+		this->peak[i] = 0;
+	}
+}
+
+void ResourceRegistry::Add(void* ptr, int type, size_t bytes, std::string tag) {
+	if(ptr == NULL) return;
+	std::lock_guard<std::mutex> guard(this->lock);
+	this->live[ptr] = { type, bytes, tag };
+	this->count[type]++;
+	this->bytes[type] += bytes;
+	if(this->bytes[type] > this->peak[type]) {
+		this->peak[type] = this->bytes[type];
+	}
+}
+
+void ResourceRegistry::Remove(void* ptr) {
+	if(ptr == NULL) return;
+	std::lock_guard<std::mutex> guard(this->lock);
+	auto it = this->live.find(ptr);
+	if(it != this->live.end()) {
+		this->count[it->second.type]--;
+		this->bytes[it->second.type] -= it->second.bytes;
+		this->live.erase(it);
+	}
+}
+
+std::string ResourceRegistry::Report() {
+	std::lock_guard<std::mutex> guard(this->lock);
+	std::string out;
+	for(int i = 0; i < RESOURCE_TYPES; i++) {
+		out += (i > 0 ? ", " : "") + std::to_string(this->count[i]) + " " + typeNames[i] + " (" +
+			std::to_string(this->bytes[i] / 1024) + " KB, peak " + std::to_string(this->peak[i] / 1024) + " KB)";
+	}
+	return out;
+}
+
+std::string ResourceRegistry::Leaks() {
+	std::lock_guard<std::mutex> guard(this->lock);
+
+	// Group live resources by tag
+	std::map<std::string, std::pair<size_t, size_t>> tags;
+	for(auto &res: this->live) {
+		auto &tag = tags[std::string(typeNames[res.second.type]) + " from " + res.second.tag];
+		tag.first++;
+		tag.second += res.second.bytes;
+	}
+
+	std::string out;
+	for(auto &tag: tags) {
+		out += "  " + std::to_string(tag.second.first) + " " + tag.first + " (" + std::to_string(tag.second.second) + " bytes)\n";
+	}
+	return out;
+}
+
+void DestroyResource(SDL_Texture* texture) {
+	registry.Remove(texture);
+	SDL_DestroyTexture(texture);
+}
+
+void DestroyResource(TTF_Font* font) {
+	registry.Remove(font);
+	TTF_CloseFont(font);
+}
+
+#ifndef __EMSCRIPTEN__
+	void DestroyResource(Mix_Chunk* chunk) {
+		registry.Remove(chunk);
+		Mix_FreeChunk(chunk);
+	}
+
+	void DestroyResource(Mix_Music* music) {
+		registry.Remove(music);
+		Mix_FreeMusic(music);
+	}
+#endif
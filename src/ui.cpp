@@ -0,0 +1,311 @@
+#include "../include/ui.hpp"
+#include "../include/profiler.hpp"
+
+Widget::Widget(int type, SDL_Rect bounds) {
+	this->type = type;
+	this->bounds = bounds;
+	this->rect = bounds;
+	this->dirty = true;
+	this->visible = true;
+	this->focused = false;
+	this->centered = false;
+	this->value = 0;
+	this->font = NULL;
+	this->image = NULL;
+	this->sprite = -1;
+	this->textColor = { 255, 255, 255, 255 };
+	this->bgColor = { 0, 0, 0, 0 };
+	this->borderColor = { 0, 0, 0, 0 };
+	this->focusColor = { 0, 0, 0, 0 };
+	this->borderSize = 0;
+	this->parent = NULL;
+}
+
+Widget::~Widget() {
+	for(auto child: this->children) {
+		delete child;
+	}
+}
+
+Widget* Widget::Add(Widget* child) {
+	child->parent = this;
+	this->children.push_back(child);
+	child->Layout();
+	return child;
+}
+
+void Widget::Layout() {
+	// Place widget and its children relative to the parent
+	if(this->parent != NULL) {
+		this->rect.x = this->parent->rect.x + this->bounds.x;
+		this->rect.y = this->parent->rect.y + this->bounds.y;
+	}
+	for(auto child: this->children) {
+		child->Layout();
+	}
+}
+
+void Widget::SetText(const std::string &text) {
+	if(this->text != text) {
+		this->text = text;
+		this->dirty = true;
+	}
+}
+
+void Widget::SetFocus(bool focused) {
+	if(this->focused != focused) {
+		this->focused = focused;
+		this->dirty = true;
+	}
+}
+
+void Widget::SetValue(int value) {
+	if(this->value != value) {
+		this->value = value;
+		this->dirty = true;
+	}
+}
+
+void Widget::SetVisible(bool visible) {
+	if(this->visible != visible) {
+		this->visible = visible;
+		this->dirty = true;
+	}
+}
+
+bool Widget::IsDirty() {
+	if(this->dirty) return true;
+	for(auto child: this->children) {
+		if(child->IsDirty()) return true;
+	}
+	return false;
+}
+
+Widget* Widget::HitTest(int x, int y) {
+	if(!this->visible) return NULL;
+
+	// Topmost children first
+	for(auto it = this->children.rbegin(); it != this->children.rend(); it++) {
+		Widget* hit = (*it)->HitTest(x, y);
+		if(hit != NULL) return hit;
+	}
+
+	// Only buttons and trackbars take mouse input
+	if(this->type != WIDGET_BUTTON && this->type != WIDGET_TRACKBAR) return NULL;
+	if(x >= this->rect.x && x < this->rect.x + this->rect.w && y >= this->rect.y && y < this->rect.y + this->rect.h) {
+		return this;
+	}
+	return NULL;
+}
+
+bool Widget::OnThumb(int x) {
+	return x >= this->rect.x + this->value && x < this->rect.x + this->value + TRACKBAR_THUMB_W;
+}
+
+int Widget::ValueAt(int x) {
+	// Track starts at the middle of the thumb in its leftmost position
+	int value = x - this->rect.x - TRACKBAR_THUMB_W / 2;
+	int max = this->rect.w - TRACKBAR_THUMB_W;
+	return (value < 0 ? 0 : (value > max ? max : value));
+}
+
+void Widget::Render(Engine* engine) {
+	PROFILE_SCOPE("RenderWidget");
+	SDL_Rect r;
+	switch(this->type) {
+		case WIDGET_LABEL:
+			// Render text (label size follows the text)
+			this->cache.Reset(this->text.empty() ? NULL : engine->RenderText(this->font, this->text, this->textColor));
+			if(this->cache != NULL && engine->QueryTexture(this->cache, &r) == 0) {
+				this->rect.w = r.w;
+				this->rect.h = r.h;
+			}
+			break;
+		case WIDGET_BUTTON:
+		case WIDGET_TRACKBAR:
+			// Render to a transparent texture of widget size
+			if(this->cache == NULL) {
+				this->cache.Reset(engine->CreateTexture(this->rect.w, this->rect.h, SDL_TEXTUREACCESS_TARGET, "Widget"));
+				if(this->cache == NULL) break;
+				SDL_SetTextureBlendMode(this->cache, SDL_BLENDMODE_BLEND);
+			}
+			engine->SetTarget(this->cache);
+			engine->SetColor({ 0, 0, 0, 0 });
+			engine->Clear();
+
+			if(this->type == WIDGET_BUTTON) {
+				// Render border and background
+				engine->SetColor(this->focused ? this->focusColor : this->borderColor);
+				engine->Clear();
+				r = { this->borderSize, this->borderSize, this->rect.w - this->borderSize * 2, this->rect.h - this->borderSize * 2 };
+				engine->SetColor(this->bgColor);
+				engine->FillRect(&r);
+
+				// Render text in the middle
+				SDL_Texture* text = engine->GetText(this->font, this->text, this->textColor);
+				if(text != NULL && engine->QueryTexture(text, &r) == 0) {
+					r.x = (this->rect.w - r.w) / 2;
+					r.y = (this->rect.h - r.h) / 2;
+					engine->Draw(text, NULL, &r);
+				}
+			} else {
+				// Render track
+				r = { TRACKBAR_THUMB_W / 2, (this->rect.h - TRACKBAR_TRACK_H) / 2, this->rect.w - TRACKBAR_THUMB_W, TRACKBAR_TRACK_H };
+				engine->SetColor(this->bgColor);
+				engine->FillRect(&r);
+
+				// Render thumb with grip lines
+				r = { this->value, 0, TRACKBAR_THUMB_W, this->rect.h };
+				engine->SetColor(this->borderColor);
+				engine->FillRect(&r);
+				engine->SetColor(this->textColor);
+				for(int y = this->rect.h / 2 - 4; y <= this->rect.h / 2 + 4; y += 4) {
+					engine->DrawLine(this->value + 2, y, 5, 1);
+				}
+			}
+
+			engine->SetTarget(NULL);
+			engine->SetColor({ 255, 255, 255, 255 });
+			break;
+	}
+	this->dirty = false;
+}
+
+void Widget::Prepare(Engine* engine) {
+	// Render changed widgets (before composing, as they use own render targets)
+	if(!this->visible) {
+		this->dirty = false;
+		return;
+	}
+	if(this->dirty) {
+		this->Render(engine);
+	}
+	for(auto child: this->children) {
+		child->Prepare(engine);
+	}
+}
+
+void Widget::Compose(Engine* engine) {
+	if(!this->visible) return;
+
+	// Draw cached widget
+	SDL_Rect r = this->rect;
+	if(this->type == WIDGET_IMAGE && this->sprite >= 0) {
+		engine->DrawSprite(this->sprite, &r);
+	} else if(this->type == WIDGET_IMAGE) {
+		engine->Draw(this->image, NULL, &r);
+	} else if(this->cache != NULL) {
+		if(this->centered && this->parent != NULL) {
+			r.x = this->parent->rect.x + (this->parent->rect.w - r.w) / 2;
+		}
+		engine->Draw(this->cache, NULL, &r);
+	}
+
+	for(auto child: this->children) {
+		child->Compose(engine);
+	}
+}
+
+void Widget::ReplaceFont(TTF_Font* from, TTF_Font* to) {
+	if(this->font == from) {
+		this->font = to;
+		this->dirty = true;
+	}
+	for(auto child: this->children) {
+		child->ReplaceFont(from, to);
+	}
+}
+
+void Widget::Free() {
+	this->cache.Reset();
+	this->dirty = true;
+	for(auto child: this->children) {
+		child->Free();
+	}
+}
+
+UI::UI(int w, int h) : root(WIDGET_PANEL, { 0, 0, w, h }) {
+	this->composes = 0;
+}
+
+Widget* UI::Add(Widget* widget) {
+	return this->root.Add(widget);
+}
+
+Widget* UI::HitTest(int x, int y) {
+	return this->root.HitTest(x, y);
+}
+
+void UI::Draw(Engine* engine) {
+	// Create screen layer
+	if(this->layer == NULL) {
+		this->layer.Reset(engine->CreateTexture(this->root.rect.w, this->root.rect.h, SDL_TEXTUREACCESS_TARGET, "UI"));
+		if(this->layer == NULL) return;
+	}
+
+	// Compose widgets only when some of them changed
+	if(this->root.IsDirty()) {
+		PROFILE_SCOPE("ComposeUI");
+		this->root.Prepare(engine);
+		engine->SetTarget(this->layer);
+		engine->SetColor({ 0, 0, 0, 255 });
+		engine->Clear();
+		this->root.Compose(engine);
+		engine->SetTarget(NULL);
+		engine->SetColor({ 255, 255, 255, 255 });
+		this->composes++;
+	}
+
+	engine->Draw(this->layer);
+}
+
+void UI::ReplaceFont(TTF_Font* from, TTF_Font* to) {
+	this->root.ReplaceFont(from, to);
+}
+
+void UI::Free() {
+	this->layer.Reset();
+	this->root.Free();
+}
+
+Widget* CreateImage(SDL_Texture* image, SDL_Rect bounds) {
+	Widget* widget = new Widget(WIDGET_IMAGE, bounds);
+	widget->image = image;
+	return widget;
+}
+
+Widget* CreateImage(int sprite, SDL_Rect bounds) {
+	Widget* widget = new Widget(WIDGET_IMAGE, bounds);
+	widget->sprite = sprite;
+	return widget;
+}
+
+Widget* CreateLabel(TTF_Font* font, std::string text, SDL_Color color, SDL_Rect bounds) {
+	Widget* widget = new Widget(WIDGET_LABEL, bounds);
+	widget->font = font;
+	widget->text = text;
+	widget->textColor = color;
+	return widget;
+}
+
+Widget* CreateButton(TTF_Font* font, std::string text, SDL_Rect bounds, SDL_Color textColor,
+		SDL_Color bgColor, SDL_Color borderColor, SDL_Color focusColor, int borderSize) {
+	Widget* widget = new Widget(WIDGET_BUTTON, bounds);
+	widget->font = font;
+	widget->text = text;
+	widget->textColor = textColor;
+	widget->bgColor = bgColor;
+	widget->borderColor = borderColor;
+	widget->focusColor = focusColor;
+	widget->borderSize = borderSize;
+	return widget;
+}
+
+Widget* CreateTrackbar(SDL_Rect bounds, int value, SDL_Color trackColor, SDL_Color thumbColor, SDL_Color lineColor) {
+	Widget* widget = new Widget(WIDGET_TRACKBAR, bounds);
+	widget->value = value;
+	widget->bgColor = trackColor;
+	widget->borderColor = thumbColor;
+	widget->textColor = lineColor;
+	return widget;
+}
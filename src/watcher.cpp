@@ -0,0 +1,115 @@
+#include "../include/watcher.hpp"
+#ifdef __linux__
+	#include <poll.h>
+	#include <unistd.h>
+	#include <sys/inotify.h>
+#endif
+
+static int JobType(const std::string &file) {
+	// Only assets that can be swapped while running
+	size_t dot = file.rfind('.');
+	if(dot == std::string::npos) return -1;
+	std::string ext = file.substr(dot + 1);
+	if(ext == "png" || ext == "jpg" || ext == "bmp") return LOAD_IMAGE;
+	if(ext == "ttf") return LOAD_FILE;
+	return -1;
+}
+
+AssetWatcher::AssetWatcher() {
+	this->fd = -1;
+	this->running = false;
+	this->reloads = 0;
+}
+
+AssetWatcher::~AssetWatcher() {
+	this->Stop();
+}
+
+bool AssetWatcher::Start(const std::vector<std::string> &dirs) {
+	#ifdef __linux__
+		this->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if(this->fd < 0) return false;
+
+		// Files are reported when written and closed or moved in (editors often save to a temporary file)
+		for(auto const &dir: dirs) {
+			int wd = inotify_add_watch(this->fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+			if(wd >= 0) this->dirs[wd] = dir;
+		}
+		if(this->dirs.empty()) {
+			close(this->fd);
+			this->fd = -1;
+			return false;
+		}
+
+		this->running = true;
+		this->thread = std::thread(&AssetWatcher::Work, this);
+		return true;
+	#else
+		return false;
+	#endif
+}
+
+void AssetWatcher::Stop() {
+	this->running = false;
+	if(this->thread.joinable()) {
+		this->thread.join();
+	}
+	#ifdef __linux__
+		if(this->fd >= 0) {
+			close(this->fd);
+			this->fd = -1;
+		}
+	#endif
+	this->dirs.clear();
+
+	std::lock_guard<std::mutex> guard(this->lock);
+	for(auto job: this->ready) {
+		FreeAsset(*job);
+		delete job;
+	}
+	this->ready.clear();
+}
+
+void AssetWatcher::Work() {
+	#ifdef __linux__
+		alignas(inotify_event) char buffer[4096];
+		while(this->running) {
+			// Wake up regularly to check if watcher was stopped
+			pollfd pfd = { this->fd, POLLIN, 0 };
+			if(poll(&pfd, 1, 100) <= 0) continue;
+
+			ssize_t len = read(this->fd, buffer, sizeof(buffer));
+			for(ssize_t i = 0; i < len;) {
+				inotify_event* event = (inotify_event*)&buffer[i];
+				i += sizeof(inotify_event) + event->len;
+				if(event->len == 0) continue;
+
+				int type = JobType(event->name);
+				auto dir = this->dirs.find(event->wd);
+				if(type < 0 || dir == this->dirs.end()) continue;
+
+				// Decode here, main thread only swaps the result in
+				LoadJob* job = new LoadJob(type, dir->second + "/" + event->name);
+				LoadAsset(*job);
+
+				std::lock_guard<std::mutex> guard(this->lock);
+				this->ready.push_back(job);
+			}
+		}
+	#endif
+}
+
+LoadJob* AssetWatcher::Next() {
+	std::lock_guard<std::mutex> guard(this->lock);
+	if(this->ready.empty()) return NULL;
+	LoadJob* job = this->ready.front();
+	this->ready.pop_front();
+	return job;
+}
+
+void AssetWatcher::Done(LoadJob* job) {
+	if(job == NULL) return;
+	if(!job->failed) this->reloads++;
+	FreeAsset(*job);
+	delete job;
+}
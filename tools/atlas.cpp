@@ -0,0 +1,187 @@
+// Packs images from a directory into atlas pages and writes a sprite index
+// Usage: atlas <images directory> [page size]
+#define SDL_MAIN_HANDLED
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <iostream>
+#include <algorithm>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+// Empty pixels between sprites (prevents bleeding when scaling)
+#define ATLAS_PADDING 1
+
+struct Image {
+	std::string name;
+	SDL_Surface* surface;
+	int page;
+	SDL_Rect rect;
+};
+
+struct Page {
+	SDL_Surface* surface;
+	int shelfY; // Top of the current shelf
+	int shelfH; // Height of the current shelf
+	int cursorX; // Next free position on the current shelf
+};
+
+bool IsImage(const std::string &file) {
+	size_t dot = file.rfind('.');
+	if(dot == std::string::npos) return false;
+	std::string ext = file.substr(dot + 1);
+	return ext == "png" || ext == "jpg" || ext == "bmp";
+}
+
+bool Place(Page &page, int size, Image &image) {
+	int w = image.rect.w + ATLAS_PADDING;
+	int h = image.rect.h + ATLAS_PADDING;
+
+	// Start a new shelf when the current one is full
+	if(page.cursorX + w > size) {
+		page.shelfY += page.shelfH;
+		page.shelfH = 0;
+		page.cursorX = 0;
+	}
+	if(page.shelfY + h > size) {
+		return false;
+	}
+
+	image.rect.x = page.cursorX;
+	image.rect.y = page.shelfY;
+	page.cursorX += w;
+	if(h > page.shelfH) page.shelfH = h;
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	if(argc < 2) {
+		std::cerr << "Usage: " << argv[0] << " <images directory> [page size]" << std::endl;
+		return 1;
+	}
+	std::string dir = argv[1];
+	int size = (argc > 2 ? atoi(argv[2]) : 2048);
+	if(size <= 0) size = 2048;
+
+	if(SDL_Init(0) < 0 || IMG_Init(IMG_INIT_PNG | IMG_INIT_JPG) == 0) {
+		std::cerr << "Can't initialize SDL (" << SDL_GetError() << ")" << std::endl;
+		return 1;
+	}
+
+	// Load every image in the directory (except previous atlas pages)
+	std::vector<Image> images;
+	DIR* d = opendir(dir.c_str());
+	if(d == NULL) {
+		std::cerr << "Can't open " << dir << std::endl;
+		return 1;
+	}
+	while(dirent* entry = readdir(d)) {
+		std::string file = entry->d_name;
+		if(!IsImage(file) || file.compare(0, 5, "atlas") == 0) continue;
+
+		SDL_Surface* loaded = IMG_Load((dir + "/" + file).c_str());
+		if(loaded == NULL) {
+			std::cerr << "Can't load " << file << " (" << IMG_GetError() << ")" << std::endl;
+			return 1;
+		}
+		SDL_Surface* surface = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+		SDL_FreeSurface(loaded);
+		if(surface == NULL) {
+			std::cerr << "Can't convert " << file << " (" << SDL_GetError() << ")" << std::endl;
+			return 1;
+		}
+		if(surface->w + ATLAS_PADDING > size || surface->h + ATLAS_PADDING > size) {
+			std::cerr << file << " doesn't fit on a page with padding (page size " << size << ")" << std::endl;
+			return 1;
+		}
+
+		Image image;
+		image.name = file.substr(0, file.rfind('.'));
+		image.surface = surface;
+		image.page = -1;
+		image.rect = { 0, 0, surface->w, surface->h };
+		images.push_back(image);
+	}
+	closedir(d);
+
+	// Tallest images first gives the tightest shelves
+	std::sort(images.begin(), images.end(), [](const Image &a, const Image &b) {
+		if(a.rect.h != b.rect.h) return a.rect.h > b.rect.h;
+		return a.name < b.name;
+	});
+
+	// Place images on the first page with room, opening new pages as needed
+	std::vector<Page> pages;
+	for(auto &image: images) {
+		for(size_t i = 0; i < pages.size() && image.page < 0; i++) {
+			Page copy = pages[i];
+			if(Place(copy, size, image)) {
+				pages[i] = copy;
+				image.page = i;
+			}
+		}
+		if(image.page < 0) {
+			Page page = { NULL, 0, 0, 0 };
+			if(!Place(page, size, image)) {
+				std::cerr << "Can't place " << image.name << " on an empty page (page size " << size << ")" << std::endl;
+				return 1;
+			}
+			pages.push_back(page);
+			image.page = pages.size() - 1;
+		}
+	}
+
+	// Pages are cropped to the used area
+	for(size_t i = 0; i < pages.size(); i++) {
+		int w = 0, h = 0;
+		for(auto &image: images) {
+			if(image.page != (int)i) continue;
+			w = std::max(w, image.rect.x + image.rect.w);
+			h = std::max(h, image.rect.y + image.rect.h);
+		}
+		pages[i].surface = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_RGBA32);
+		if(pages[i].surface == NULL) {
+			std::cerr << "Can't create page (" << SDL_GetError() << ")" << std::endl;
+			return 1;
+		}
+		SDL_FillRect(pages[i].surface, NULL, 0);
+	}
+
+	// Copy images and write index
+	std::string indexPath = dir + "/atlas.txt";
+	FILE* index = fopen(indexPath.c_str(), "w");
+	if(index == NULL) {
+		std::cerr << "Can't write " << indexPath << std::endl;
+		return 1;
+	}
+	fprintf(index, "# Generated by atlas tool, do not edit\n");
+	for(size_t i = 0; i < pages.size(); i++) {
+		fprintf(index, "page atlas%u.png\n", (unsigned)i);
+	}
+	for(auto &image: images) {
+		SDL_SetSurfaceBlendMode(image.surface, SDL_BLENDMODE_NONE);
+		SDL_Rect dst = image.rect;
+		SDL_BlitSurface(image.surface, NULL, pages[image.page].surface, &dst);
+		fprintf(index, "sprite %s %d %d %d %d %d\n", image.name.c_str(), image.page, image.rect.x, image.rect.y, image.rect.w, image.rect.h);
+		SDL_FreeSurface(image.surface);
+	}
+	fclose(index);
+
+	for(size_t i = 0; i < pages.size(); i++) {
+		std::string pagePath = dir + "/atlas" + std::to_string(i) + ".png";
+		if(IMG_SavePNG(pages[i].surface, pagePath.c_str()) < 0) {
+			std::cerr << "Can't write " << pagePath << " (" << IMG_GetError() << ")" << std::endl;
+			return 1;
+		}
+		std::cout << pagePath << ": " << pages[i].surface->w << "x" << pages[i].surface->h << std::endl;
+		SDL_FreeSurface(pages[i].surface);
+	}
+	std::cout << images.size() << " sprites packed into " << pages.size() << " page(s)" << std::endl;
+
+	IMG_Quit();
+	SDL_Quit();
+	return 0;
+}
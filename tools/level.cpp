@@ -0,0 +1,90 @@
+// Converts a level description to the binary level format
+// Usage: level <input text file> <output file>
+//
+// Input lines (# starts a comment):
+//   stage [flip]
+//   rect <x> <y> <w> <h>
+//   triangle <x> <y> <size> <up|down|left|right> [layer] [r g b a]
+#define SDL_MAIN_HANDLED
+#include <string>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include "../include/level.hpp"
+#include "../include/engine.hpp"
+
+int Direction(const std::string &name) {
+	if(name == "up") return TRIANGLE_UP;
+	if(name == "down") return TRIANGLE_DOWN;
+	if(name == "left") return TRIANGLE_LEFT;
+	if(name == "right") return TRIANGLE_RIGHT;
+	return -1;
+}
+
+int main(int argc, char* argv[]) {
+	if(argc < 3) {
+		std::cerr << "Usage: " << argv[0] << " <input text file> <output file>" << std::endl;
+		return 1;
+	}
+	std::ifstream input(argv[1]);
+	if(!input) {
+		std::cerr << "Can't open " << argv[1] << std::endl;
+		return 1;
+	}
+
+	LevelBuilder builder;
+	std::string line;
+	size_t rects = 0, shapes = 0;
+	for(int number = 1; std::getline(input, line); number++) {
+		size_t comment = line.find('#');
+		if(comment != std::string::npos) line.erase(comment);
+		std::istringstream words(line);
+		std::string command;
+		if(!(words >> command)) continue;
+
+		bool ok = true;
+		if(command == "stage") {
+			std::string flag;
+			builder.AddStage(words >> flag && flag == "flip" ? STAGE_FLIP : 0);
+		} else if(command == "rect") {
+			SDL_Rect rect;
+			ok = (words >> rect.x >> rect.y >> rect.w >> rect.h) && rect.w > 0 && rect.h > 0 && builder.Count() > 0;
+			if(ok) {
+				builder.AddRect(rect);
+				rects++;
+			}
+		} else if(command == "triangle") {
+			int x, y, size, layer = 1, r = 0, g = 0, b = 0, a = 255;
+			std::string direction;
+			ok = (words >> x >> y >> size >> direction) && Direction(direction) >= 0 && builder.Count() > 0;
+			if(ok && words >> layer) {
+				words >> r >> g >> b >> a;
+			}
+			if(ok) {
+				builder.AddTriangle(x, y, size, Direction(direction), { (uint8_t)r, (uint8_t)g, (uint8_t)b, (uint8_t)a }, layer);
+				shapes++;
+			}
+		} else {
+			ok = false;
+		}
+		if(!ok) {
+			std::cerr << argv[1] << ":" << number << ": invalid line" << std::endl;
+			return 1;
+		}
+	}
+	if(builder.Count() == 0) {
+		std::cerr << argv[1] << " has no stages" << std::endl;
+		return 1;
+	}
+
+	// Read the result back to check it
+	Level level;
+	if(!builder.Save(argv[2]) || !level.Open(argv[2]) || level.Count() != builder.Count()) {
+		std::cerr << "Can't write " << argv[2] << std::endl;
+		return 1;
+	}
+	std::cout << level.Count() << " stages, " << rects << " platforms and " << shapes << " shapes written to " << argv[2] <<
+		" (" << level.Size() << " bytes)" << std::endl;
+	return 0;
+}
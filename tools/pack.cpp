@@ -0,0 +1,158 @@
+// Bakes game assets into one pack file (images are stored decoded)
+// Usage: pack <output> <game directory> <subdirectory>...
+#define SDL_MAIN_HANDLED
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <iostream>
+#include <algorithm>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include "../include/pack.hpp"
+
+// Pixel format used by most renderers (uploaded without conversion)
+#define PACK_FORMAT SDL_PIXELFORMAT_ARGB8888
+
+struct Asset {
+	PackEntry entry;
+	std::vector<uint8_t> data;
+};
+
+bool IsImage(const std::string &file) {
+	size_t dot = file.rfind('.');
+	if(dot == std::string::npos) return false;
+	std::string ext = file.substr(dot + 1);
+	return ext == "png" || ext == "jpg" || ext == "bmp";
+}
+
+bool ReadFile(const std::string &path, std::vector<uint8_t> &out) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if(file == NULL) return false;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	out.resize(size > 0 ? size : 0);
+	bool ok = (size >= 0 && fread(out.data(), 1, out.size(), file) == out.size());
+	fclose(file);
+	return ok;
+}
+
+bool DecodeImage(const std::string &path, Asset &asset) {
+	SDL_Surface* loaded = IMG_Load(path.c_str());
+	if(loaded == NULL) return false;
+	SDL_Surface* surface = SDL_ConvertSurfaceFormat(loaded, PACK_FORMAT, 0);
+	SDL_FreeSurface(loaded);
+	if(surface == NULL) return false;
+
+	// Rows are stored tightly packed
+	int pitch = surface->w * 4;
+	asset.entry.type = PACK_PIXELS;
+	asset.entry.format = PACK_FORMAT;
+	asset.entry.width = surface->w;
+	asset.entry.height = surface->h;
+	asset.entry.pitch = pitch;
+	asset.data.resize((size_t)pitch * surface->h);
+	SDL_LockSurface(surface);
+	for(int y = 0; y < surface->h; y++) {
+		memcpy(&asset.data[(size_t)y * pitch], (uint8_t*)surface->pixels + (size_t)y * surface->pitch, pitch);
+	}
+	SDL_UnlockSurface(surface);
+	SDL_FreeSurface(surface);
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	if(argc < 4) {
+		std::cerr << "Usage: " << argv[0] << " <output> <game directory> <subdirectory>..." << std::endl;
+		return 1;
+	}
+	std::string base = argv[2];
+
+	if(SDL_Init(0) < 0 || IMG_Init(IMG_INIT_PNG | IMG_INIT_JPG) == 0) {
+		std::cerr << "Can't initialize SDL (" << SDL_GetError() << ")" << std::endl;
+		return 1;
+	}
+
+	std::vector<Asset> assets;
+	for(int i = 3; i < argc; i++) {
+		std::string sub = argv[i];
+		DIR* d = opendir((base + "/" + sub).c_str());
+		if(d == NULL) {
+			std::cerr << "Can't open " << base << "/" << sub << std::endl;
+			return 1;
+		}
+		std::vector<std::string> files;
+		while(dirent* entry = readdir(d)) {
+			if(entry->d_name[0] != '.') files.push_back(entry->d_name);
+		}
+		closedir(d);
+		std::sort(files.begin(), files.end());
+
+		// Images already packed into an atlas are left out
+		bool atlas = std::find(files.begin(), files.end(), "atlas.txt") != files.end();
+
+		for(auto &file: files) {
+			if(atlas && IsImage(file) && file.compare(0, 5, "atlas") != 0) continue;
+
+			std::string name = sub + "/" + file;
+			if(name.size() >= PACK_NAME_SIZE) {
+				std::cerr << name << " has too long name" << std::endl;
+				return 1;
+			}
+			Asset asset;
+			memset(&asset.entry, 0, sizeof(asset.entry));
+			strcpy(asset.entry.name, name.c_str());
+
+			std::string path = base + "/" + name;
+			bool ok = IsImage(file) ? DecodeImage(path, asset) : ReadFile(path, asset.data);
+			if(!ok) {
+				std::cerr << "Can't read " << path << std::endl;
+				return 1;
+			}
+			asset.entry.size = asset.data.size();
+			assets.push_back(asset);
+		}
+	}
+
+	// Data follows the table of contents
+	uint64_t offset = sizeof(PackHeader) + assets.size() * sizeof(PackEntry);
+	for(auto &asset: assets) {
+		offset = (offset + PACK_ALIGN - 1) / PACK_ALIGN * PACK_ALIGN;
+		asset.entry.offset = offset;
+		offset += asset.entry.size;
+	}
+
+	FILE* out = fopen(argv[1], "wb");
+	if(out == NULL) {
+		std::cerr << "Can't write " << argv[1] << std::endl;
+		return 1;
+	}
+	PackHeader header;
+	memcpy(header.magic, PACK_MAGIC, 4);
+	header.version = PACK_VERSION;
+	header.count = assets.size();
+	header.reserved = 0;
+	fwrite(&header, sizeof(header), 1, out);
+	for(auto &asset: assets) {
+		fwrite(&asset.entry, sizeof(asset.entry), 1, out);
+	}
+	for(auto &asset: assets) {
+		static const uint8_t zeros[PACK_ALIGN] = { 0 };
+		fwrite(zeros, 1, asset.entry.offset - ftell(out), out);
+		fwrite(asset.data.data(), 1, asset.data.size(), out);
+		std::cout << asset.entry.name << ": " << asset.data.size() << " bytes" << std::endl;
+	}
+	bool ok = (ferror(out) == 0);
+	fclose(out);
+	if(!ok) {
+		std::cerr << "Can't write " << argv[1] << std::endl;
+		return 1;
+	}
+	std::cout << assets.size() << " assets packed into " << argv[1] << " (" << offset << " bytes)" << std::endl;
+
+	IMG_Quit();
+	SDL_Quit();
+	return 0;
+}